@@ -0,0 +1,175 @@
+// Benchmark for the binary batch encoding (DHTBatchEncoder) versus JSON
+//
+// Encodes a sequence of samples taken every 30 seconds (slowly changing temperature and humidity)
+// two ways, and reports the size and time to encode for each:
+//
+// - JSON, one object per sample formatted with snprintf and %.1f, like the 3-publish example
+// - DHTBatchEncoder, with varint/zigzag deltas, then base64
+//
+// It also reports how many samples fit in one 622 byte publish for each, and checks that
+// DHTBatchDecoder returns the original samples.
+//
+// This runs on a device like the other examples (results are logged to USB serial), but since
+// DHTBatch doesn't depend on Particle.h it can also be built and run on a Linux or Mac computer
+// from the top of the library. This also shows how to decode the published data on a server:
+//
+//   g++ -O2 -Isrc examples/10-batch-encoding/10-batch-encoding.cpp src/DHTBatch.cpp -o batch-benchmark
+//   ./batch-benchmark
+
+#include "DHTBatch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef PARTICLE
+#include "Particle.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+#define BENCH_LOG(...) Log.info(__VA_ARGS__)
+
+static uint32_t benchMicros() { return micros(); }
+#else
+#include <chrono>
+
+#define BENCH_LOG(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+
+static uint32_t benchMicros() {
+	return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+const size_t PUBLISH_SIZE = 622;	// Maximum publish data size, including the null terminator
+const size_t MAX_SAMPLES = 200;
+const int ITERATIONS = 200;
+const uint32_t SAMPLE_INTERVAL_SEC = 30;
+
+static uint32_t times[MAX_SAMPLES];
+static int16_t temps[MAX_SAMPLES];
+static int16_t humidities[MAX_SAMPLES];
+static uint32_t seed = 1;
+
+static char text[PUBLISH_SIZE];
+static uint8_t binary[PUBLISH_SIZE];
+
+static uint32_t nextRandom() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static void makeSamples() {
+	int temp = 215;
+	int humidity = 450;
+	for(size_t ii = 0; ii < MAX_SAMPLES; ii++) {
+		times[ii] = 1700000000 + ii * SAMPLE_INTERVAL_SEC;
+		temp += (int)(nextRandom() % 5) - 2;
+		humidity += (int)(nextRandom() % 7) - 3;
+		temps[ii] = (int16_t)temp;
+		humidities[ii] = (int16_t)humidity;
+	}
+}
+
+// Returns the number of samples that fit, with the text in text
+static size_t encodeJson(size_t numSamples) {
+	size_t offset = 0;
+	size_t count = 0;
+	text[offset++] = '[';
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		char item[64];
+		int len = snprintf(item, sizeof(item), "%s{\"t\":%lu,\"temp\":%.1f,\"hum\":%.1f}", (ii ? "," : ""),
+				(unsigned long)times[ii], temps[ii] / 10.0f, humidities[ii] / 10.0f);
+		if (offset + len + 2 > PUBLISH_SIZE) {
+			break;
+		}
+		memcpy(&text[offset], item, len);
+		offset += len;
+		count++;
+	}
+	text[offset++] = ']';
+	text[offset] = 0;
+	return count;
+}
+
+// Returns the number of samples that fit, with the text in text
+static size_t encodeBatch(size_t numSamples) {
+	DHTBatchEncoder encoder(binary, DHTBatchEncoder::getMaxBinarySize(PUBLISH_SIZE));
+	size_t count = 0;
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		if (!encoder.add(times[ii], temps[ii], humidities[ii])) {
+			break;
+		}
+		count++;
+	}
+	encoder.encodeBase64(text, sizeof(text));
+	return count;
+}
+
+static bool checkDecode(size_t numSamples) {
+	uint8_t data[PUBLISH_SIZE];
+	size_t dataLen = DHTBatchDecoder::base64Decode(text, data, sizeof(data));
+
+	DHTBatchDecoder decoder(data, dataLen);
+	uint32_t timeSec;
+	int16_t tempDeciC, humidityDeci;
+	size_t ii = 0;
+	while(decoder.next(timeSec, tempDeciC, humidityDeci)) {
+		if (ii >= numSamples || timeSec != times[ii] || tempDeciC != temps[ii] || humidityDeci != humidities[ii]) {
+			return false;
+		}
+		ii++;
+	}
+	return !decoder.isError() && ii == numSamples;
+}
+
+typedef size_t (*EncodeFn)(size_t numSamples);
+
+static void runCase(const char *name, EncodeFn encode, size_t numSamples) {
+	size_t count = encode(numSamples);
+	size_t len = strlen(text);
+	bool decoded = (encode == encodeBatch) ? checkDecode(count) : true;
+
+	uint32_t start = benchMicros();
+	for(int iter = 0; iter < ITERATIONS; iter++) {
+		encode(numSamples);
+	}
+	uint32_t elapsedUs = benchMicros() - start;
+
+	BENCH_LOG("%-6s samples=%3u bytes=%4u bytes/sample=%5.1f ns/batch=%9lu ns/sample=%6lu%s",
+			name, (unsigned)count, (unsigned)len, count ? (float)len / count : 0.0f,
+			(unsigned long)((uint64_t)elapsedUs * 1000 / ITERATIONS),
+			count ? (unsigned long)((uint64_t)elapsedUs * 1000 / ITERATIONS / count) : 0UL,
+			decoded ? "" : " DECODE FAILED");
+}
+
+static void runBenchmarks() {
+	makeSamples();
+
+	BENCH_LOG("10 samples:");
+	runCase("json", encodeJson, 10);
+	runCase("batch", encodeBatch, 10);
+
+	BENCH_LOG("as many samples as fit in %u bytes:", (unsigned)PUBLISH_SIZE);
+	runCase("json", encodeJson, MAX_SAMPLES);
+	runCase("batch", encodeBatch, MAX_SAMPLES);
+}
+
+#ifdef PARTICLE
+void setup() {
+	waitFor(Serial.isConnected, 15000);
+	delay(1000);
+
+	runBenchmarks();
+}
+
+void loop() {
+}
+#else
+int main() {
+	runBenchmarks();
+	return 0;
+}
+#endif
@@ -0,0 +1,69 @@
+// Example that reads two sensors from a separate thread using readSample()
+//
+// With withWorkerThread(), DHT22Gen3 runs its state machine on its own thread. readSample()
+// queues a request and blocks the calling thread on a semaphore until the sample is done, so the
+// reader thread can be written as simple sequential code, and loop() can be busy (here it just
+// delays) without slowing down the samples.
+
+#include "DHT22Gen3_RK.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+// How often the reader thread reads the sensors in milliseconds
+const unsigned long READ_INTERVAL = 10000;
+
+// The two parameters are any available GPIO pins. They will be used as output but the signals aren't
+// particularly important for DHT11 and DHT22 sensors. They do need to be valid pins, however.
+DHT22Gen3 dht(A4, A5);
+
+Thread *readerThread;
+
+os_thread_return_t readerThreadFunction(void *param);
+void logSample(const char *name, const DHTSample &sample);
+
+void setup() {
+	dht.withWorkerThread().setup();
+
+	readerThread = new Thread("reader", readerThreadFunction);
+}
+
+void loop() {
+	// Still required for getSample() completions and periodic samples, but readSample() does not
+	// depend on it
+	dht.loop();
+
+	// Simulate an application that is busy for long periods
+	delay(2000);
+}
+
+os_thread_return_t readerThreadFunction(void *param) {
+	while(true) {
+		unsigned long start = millis();
+
+		// Each call returns when the sample is done, about 5 milliseconds for a DHT22. The sensors
+		// are on different pins, so the second one doesn't have to wait for the minimum sample period.
+		DHTSample sample = dht.readSample(A3);
+		logSample("A3", sample);
+
+		sample = dht.readSample<DHTTraitsDHT11>(D2);
+		logSample("D2", sample);
+
+		Log.info("read both sensors in %lu ms", millis() - start);
+
+		delay(READ_INTERVAL);
+	}
+}
+
+void logSample(const char *name, const DHTSample &sample) {
+	if (sample.isSuccess()) {
+		Log.info("%s tempC=%.1f humidity=%.1f tries=%d", name, sample.getTempC(), sample.getHumidity(), sample.getTries());
+	}
+	else if (sample.isTimeout()) {
+		Log.info("%s timed out", name);
+	}
+	else {
+		Log.info("%s sample is not valid sampleResult=%d", name, (int) sample.getSampleResult());
+	}
+}
@@ -0,0 +1,382 @@
+// Tests for DHT22Gen3 using the simulated backend
+//
+// Runs the library against DHTBackendSimulated and checks the results of cases that are hard to
+// set up with real sensors. Unlike the other examples this one only runs on a Linux or Mac
+// computer, using the small Particle.h replacement in the host directory. From the top of the
+// library:
+//
+//   g++ -std=c++11 -O2 -Wall -Isrc -Iexamples/12-simulated-tests/host examples/12-simulated-tests/12-simulated-tests.cpp examples/12-simulated-tests/host/*.cpp src/DHT22Gen3_RK.cpp src/DHTBackendSimulated.cpp src/DHTDecoder.cpp src/DHTCaptureSynth.cpp src/DHTStats.cpp src/DHTBatch.cpp -o simulated-tests
+//   ./simulated-tests
+//
+// Each check that fails is printed, and the program exits with a non-zero status if any failed.
+
+#include "DHT22Gen3_RK.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <new>
+
+static int failures = 0;
+
+// Counts calls to operator new while countAllocations is set. A std::function or other
+// allocating wrapper for the completions would show up here.
+static bool countAllocations = false;
+static int allocations = 0;
+
+void *operator new(size_t size) {
+	if (countAllocations) {
+		allocations++;
+	}
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	free(ptr);
+}
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+static void check(bool cond, const char *text, const char *file, int line) {
+	if (!cond) {
+		printf("%s:%d: check failed: %s\n", file, line, text);
+		failures++;
+	}
+}
+
+// Reads the sensor on D2 once, calling loop() until the sample completes
+static DHTSample readOnce(DHT22Gen3 &dht, DHTBackendSimulated &sim, DHTSensorType *sensorType) {
+	DHTSample result;
+	bool done = false;
+
+	dht.getSample(D2, [&](const DHTSample &sample) {
+		result = sample;
+		done = true;
+	}, sensorType);
+
+	for(int ii = 0; ii < 100000 && !done; ii++) {
+		dht.loop();
+	}
+	CHECK(done);
+
+	// Wait out the minimum sample period before the next read
+	sim.advance(2100000);
+
+	return result;
+}
+
+// DHT22Gen3 stops the capture as soon as the decoder has all 40 bits. With edge capture that's
+// one edge before the end of the frame, and the sample must still succeed.
+static void testStopAfterFrame() {
+	for(int edge = 0; edge < 2; edge++) {
+		for(int dht11 = 0; dht11 < 2; dht11++) {
+			DHTBackendSimulated sim;
+			DHT22Gen3 dht(&sim);
+
+			// A small tick so loop() sees the 40th bit before the final edge arrives
+			sim.withSensor(D2, dht11 ? 210 : 215, 452, dht11).withEdgeCapture(edge).withJitter(5).withTickUs(10);
+			dht.setup();
+
+			DHTSensorType *sensorType = dht11 ? (DHTSensorType *)&DHT22Gen3::sensorTypeDHT11 : (DHTSensorType *)&DHT22Gen3::sensorTypeDHT22;
+
+			int success = 0;
+			int stoppedEarly = 0;
+			for(int ii = 0; ii < 50; ii++) {
+				DHTSample sample = readOnce(dht, sim, sensorType);
+				if (sample.isSuccess() && sample.getTempDeciC() == (dht11 ? 210 : 215)) {
+					success++;
+				}
+				if (edge && sim.getEdgeCount() == DHTBackend::EDGES_PER_FRAME - 1) {
+					stoppedEarly++;
+				}
+			}
+			printf("stop after frame: %s %s success=%d stoppedEarly=%d\n", edge ? "edge" : "i2s", dht11 ? "DHT11" : "DHT22", success, stoppedEarly);
+			CHECK(success == 50);
+			if (edge) {
+				CHECK(stoppedEarly > 0);
+			}
+		}
+	}
+
+	// The simulated edge backend reports the same result from stopCapture() as DHTBackendNRF52Edge
+	for(size_t stopAt = DHTBackend::EDGES_PER_FRAME - 2; stopAt <= DHTBackend::EDGES_PER_FRAME; stopAt++) {
+		DHTBackendSimulated sim;
+		sim.withSensor(D2, 215, 452).withEdgeCapture(true).withTickUs(1);
+		sim.setup();
+
+		CHECK(sim.startTimedCapture(D2, DHT22Gen3::sensorTypeDHT22.startPulseUs, DHT22Gen3::sensorTypeDHT22.captureConfig));
+		for(int ii = 0; ii < 10000 && sim.getEdgeCount() < stopAt; ii++) {
+			sim.advance(1);
+		}
+		CHECK(sim.getEdgeCount() == stopAt);
+		CHECK(sim.stopCapture() == (stopAt >= DHTBackend::EDGES_PER_FRAME - 1));
+	}
+}
+
+// A custom sensor type, like ones written for version 0.0.4 and earlier, that decodes like a DHT22
+class CustomSensorType : public DHTSensorType {
+public:
+	CustomSensorType(unsigned long oneBitThreshold) : DHTSensorType("custom", 2000, oneBitThreshold) {};
+	CustomSensorType(unsigned long oneBitThreshold, const DHTCaptureConfig &captureConfig) : DHTSensorType("custom", 2000, oneBitThreshold, captureConfig) {};
+
+	virtual float getTempC(const DHTSample &sample) const { return DHT22Gen3::sensorTypeDHT22.getTempC(sample); };
+	virtual float getHumidity(const DHTSample &sample) const { return DHT22Gen3::sensorTypeDHT22.getHumidity(sample); };
+};
+
+// Custom sensor types from the 3-parameter constructor have a threshold for 512 kHz, but must fit
+// in the default capture buffer. Captures that don't fit fail, like on the hardware.
+static void testLegacySensorType() {
+	CustomSensorType legacy(25);
+	CHECK(legacy.captureConfig.numWords <= DHT22GEN3_MAX_CAPTURE_WORDS);
+	CHECK(legacy.oneBitThreshold == 6);
+
+	CustomSensorType large(25, DHTCaptureConfig::CONFIG_512K);
+
+	DHTBackendSimulated sim;
+	DHT22Gen3 dht(&sim);
+	sim.withSensor(D2, 215, 452).withJitter(5);
+	dht.setup();
+
+	int success = 0;
+	for(int ii = 0; ii < 20; ii++) {
+		DHTSample sample = readOnce(dht, sim, &legacy);
+		if (sample.isSuccess() && legacy.getTempDeciC(sample) == 215) {
+			success++;
+		}
+	}
+	printf("legacy sensor type: success=%d\n", success);
+	CHECK(success == 20);
+
+	DHTSample sample = readOnce(dht, sim, &large);
+	CHECK(sample.getSampleResult() == DHTSample::SampleResult::ERROR);
+}
+
+// Exposes the protected members used by the tests
+class TestDHT22Gen3 : public DHT22Gen3 {
+public:
+	TestDHT22Gen3(DHTBackend *backend) : DHT22Gen3(backend) {};
+
+	using DHT22Gen3::getWorkerTimeout;
+};
+
+// The worker thread sleeps until the sensor can be read again instead of waking every millisecond.
+// There are no threads here; process() is called to do the work of the worker thread.
+static void testWorkerTimeout() {
+	DHTBackendSimulated sim;
+	TestDHT22Gen3 dht(&sim);
+	sim.withSensor(D2, 215, 452);
+	dht.withWorkerThread().setup();
+
+	CHECK(dht.getWorkerTimeout() == CONCURRENT_WAIT_FOREVER);
+
+	int count = 0;
+	for(int ii = 0; ii < 2; ii++) {
+		dht.getSample(D2, [&count](const DHTSample &sample) {
+			if (sample.isSuccess()) {
+				count++;
+			}
+		});
+	}
+
+	// First sample: start pulse and capture
+	int wakes = 0;
+	while(count == 0 && wakes < 10000) {
+		dht.process();
+		if (dht.getWorkerTimeout() != 1) {
+			break;
+		}
+		wakes++;
+		dht.loop();
+	}
+	dht.loop();
+	CHECK(count == 1);
+
+	// Second sample on the same pin waits for the minimum sample period of 2 seconds
+	system_tick_t timeout = dht.getWorkerTimeout();
+	printf("worker timeout: %d wakes for the first sample, then %lu ms until the second\n", wakes, (unsigned long)timeout);
+	CHECK(timeout > 1900 && timeout <= DHT22Gen3::sensorTypeDHT22.minSamplePeriodMs);
+
+	sim.advance(timeout * 1000);
+	for(int ii = 0; ii < 10000 && count < 2; ii++) {
+		dht.process();
+		dht.loop();
+	}
+	CHECK(count == 2);
+	CHECK(dht.getWorkerTimeout() == CONCURRENT_WAIT_FOREVER);
+}
+
+// Diagnostics removed while a frame is being decoded are not written to afterwards
+static void testRemoveDiagnostics() {
+	DHTBackendSimulated sim;
+	DHT22Gen3 dht(&sim);
+	sim.withSensor(D2, 215, 452);
+	dht.withWorkerThread().setup();
+
+	DHTSensorDiagnostics diagnostics;
+	CHECK(dht.addDiagnostics(D2, &diagnostics));
+
+	int count = 0;
+	dht.getSample(D2, [&count](const DHTSample &sample) {
+		if (sample.isSuccess()) {
+			count++;
+		}
+	});
+
+	// Remove the diagnostics once part of the frame has been decoded
+	while(diagnostics.lastFrame.pairs < 10) {
+		dht.process();
+	}
+	CHECK(dht.removeDiagnostics(D2));
+	DHTSensorDiagnostics removed = diagnostics;
+
+	for(int ii = 0; ii < 10000 && count == 0; ii++) {
+		dht.process();
+		dht.loop();
+	}
+	CHECK(count == 1);
+	CHECK(diagnostics.frames == 0);
+	CHECK(diagnostics.lastFrame.pairs == removed.lastFrame.pairs);
+}
+
+// A periodic entry removed while its sample is in progress doesn't deliver that sample to a new
+// entry in the same slot, and updating an entry doesn't start a second sample while one is in progress
+static void testPeriodicReplace() {
+	for(int replace = 0; replace < 2; replace++) {
+		DHTBackendSimulated sim;
+		DHT22Gen3 dht(&sim);
+		sim.withSensor(D2, 215, 452).withSensor(D3, 220, 460);
+		dht.setup();
+
+		int countD3 = 0;
+		dht.addPeriodicSample(D3, 60000, [&countD3](const DHTSample &) {
+			countD3++;
+		});
+
+		// Starts the first sample for D3
+		dht.loop();
+		size_t queueCount = dht.getQueueCount();
+
+		int countD2 = 0;
+		int wrongPin = 0;
+		if (replace) {
+			dht.removePeriodicSample(D3);
+			dht.addPeriodicSample(D2, 60000, [&countD2, &wrongPin](const DHTSample &sample) {
+				countD2++;
+				if (sample.getTempDeciC() != 215) {
+					wrongPin++;
+				}
+			});
+		}
+		else {
+			dht.addPeriodicSample(D3, 60000, [&countD3](const DHTSample &) {
+				countD3++;
+			});
+
+			// The sample in progress is still pending, so no second one is queued
+			dht.loop();
+			CHECK(dht.getQueueCount() == queueCount);
+		}
+
+		// 10 seconds, enough for the samples in progress but less than the interval
+		for(int ii = 0; ii < 10000; ii++) {
+			dht.loop();
+			sim.advance(1000);
+		}
+
+		printf("periodic %s: D3=%d D2=%d wrongPin=%d\n", replace ? "replace" : "update", countD3, countD2, wrongPin);
+		if (replace) {
+			CHECK(countD3 == 0);
+			CHECK(countD2 == 1);
+			CHECK(wrongPin == 0);
+		}
+		else {
+			CHECK(countD3 > 0);
+		}
+	}
+}
+
+// getSample() through the completion does not allocate memory, from loop() or with the worker
+// thread, including retries, periodic samples, histories, and statistics
+static void testNoAllocation() {
+	const int NUM_REQUESTS = 10000;
+
+	for(int worker = 0; worker < 2; worker++) {
+		DHTBackendSimulated sim;
+		DHT22Gen3 dht(&sim);
+		sim.withSensor(D2, 215, 452).withSensor(D3, 220, 460).withTruncatePercent(5);
+		if (worker) {
+			dht.withWorkerThread();
+		}
+		dht.setup();
+
+		DHTHistoryBuffer<16> history;
+		DHTSensorStats stats;
+		dht.addHistory(D2, &history);
+		dht.addStats(D2, &stats);
+
+		int periodicCount = 0;
+		dht.addPeriodicSample(D3, 2000, [&periodicCount](const DHTSample &) {
+			periodicCount++;
+		});
+
+		allocations = 0;
+		countAllocations = true;
+
+		int count = 0;
+		int success = 0;
+		for(int ii = 0; ii < NUM_REQUESTS; ii++) {
+			int before = count;
+			dht.getSample(D2, [&count, &success](const DHTSample &sample) {
+				count++;
+				if (sample.isSuccess()) {
+					success++;
+				}
+			});
+			// Retries wait for the minimum sample period, so advance the clock a millisecond at a time
+			for(int jj = 0; jj < 100000 && count == before; jj++) {
+				if (worker) {
+					dht.process();
+				}
+				dht.loop();
+				sim.advance(1000);
+			}
+			sim.advance(2000000);
+		}
+
+		countAllocations = false;
+
+		printf("no allocation: %s requests=%d success=%d periodic=%d allocations=%d\n", worker ? "worker" : "loop", count, success, periodicCount, allocations);
+		CHECK(count == NUM_REQUESTS);
+		CHECK(success > NUM_REQUESTS * 9 / 10);
+		CHECK(periodicCount > 0);
+		CHECK(allocations == 0);
+	}
+}
+
+static void runTests() {
+	testStopAfterFrame();
+	testLegacySensorType();
+	testWorkerTimeout();
+	testRemoveDiagnostics();
+	testPeriodicReplace();
+	testNoAllocation();
+
+	printf("%s (%d failures)\n", failures ? "FAILED" : "passed", failures);
+}
+
+int main() {
+	runTests();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#include "DHTBackend.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// DHT22Gen3 contains a DHTBackendNRF52 even when another backend is used, so it needs these to
+// link on a host computer. They are never called by the tests.
+
+bool hostSemaphoreGiven = false;
+
+void DHTBackendNRF52::setup() {}
+void DHTBackendNRF52::prepareCapture() {}
+bool DHTBackendNRF52::startCapture(pin_t, const DHTCaptureConfig &) { return false; }
+bool DHTBackendNRF52::startTimedCapture(pin_t, uint32_t, const DHTCaptureConfig &) { return false; }
+uint32_t DHTBackendNRF52::getLastStartPulseUs() const { return 0; }
+bool DHTBackendNRF52::isCaptureComplete() { return false; }
+size_t DHTBackendNRF52::getCapturedWords() { return 0; }
+bool DHTBackendNRF52::stopCapture() { return false; }
+const uint16_t *DHTBackendNRF52::getCaptureBuffer() const { return 0; }
+size_t DHTBackendNRF52::getCaptureWords() const { return 0; }
+void DHTBackendNRF52::setCaptureHandler(void (*)(void *), void *) {}
@@ -0,0 +1,90 @@
+#ifndef _PARTICLE_HOST_H
+#define _PARTICLE_HOST_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// Minimal stand-in for the parts of Particle.h used by the library, so DHT22Gen3 can be built
+// with DHTBackendSimulated on a host computer for the 12-simulated-tests example. It is only on
+// the include path for that build; it is not used on a device.
+//
+// There are no threads: os_thread_create() succeeds without starting one, and the semaphore only
+// records that it was given, so a test calls DHT22Gen3::process() to emulate the worker thread.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+typedef uint16_t pin_t;
+typedef uint32_t system_tick_t;
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP };
+
+#define LOW 0
+#define HIGH 1
+#define PIN_INVALID 0xff
+
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define D8 8
+#define D9 9
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+#define A4 14
+#define A5 15
+
+// Only used by the default DHT22Gen3 clock; the tests use the simulated clock
+inline unsigned long micros() { return 0; }
+inline unsigned long millis() { return 0; }
+inline void pinMode(pin_t, PinMode) {}
+inline void digitalWrite(pin_t, uint8_t) {}
+
+// Set the environment variable DHT_LOG to see the library log messages
+class HostLogger {
+public:
+	void info(const char *fmt, ...) {
+		if (getenv("DHT_LOG")) {
+			va_list ap;
+			va_start(ap, fmt);
+			vprintf(fmt, ap);
+			va_end(ap);
+			printf("\n");
+		}
+	}
+};
+static HostLogger Log __attribute__((unused));
+
+typedef void *os_thread_t;
+typedef void *os_semaphore_t;
+typedef void *os_mutex_t;
+typedef void os_thread_return_t;
+typedef uint8_t os_thread_prio_t;
+
+#define OS_THREAD_PRIORITY_DEFAULT 2
+#define CONCURRENT_WAIT_FOREVER ((system_tick_t)-1)
+
+// Set by os_semaphore_give(), cleared by os_semaphore_take()
+extern bool hostSemaphoreGiven;
+
+inline int os_semaphore_create(os_semaphore_t *semaphore, unsigned, unsigned initialCount) { *semaphore = (void *)&hostSemaphoreGiven; hostSemaphoreGiven = initialCount != 0; return 0; }
+inline int os_semaphore_give(os_semaphore_t, bool) { hostSemaphoreGiven = true; return 0; }
+inline int os_semaphore_take(os_semaphore_t, system_tick_t, bool) { bool given = hostSemaphoreGiven; hostSemaphoreGiven = false; return given ? 0 : 1; }
+inline int os_mutex_create(os_mutex_t *mutex) { *mutex = (void *)&hostSemaphoreGiven; return 0; }
+inline int os_mutex_lock(os_mutex_t) { return 0; }
+inline int os_mutex_unlock(os_mutex_t) { return 0; }
+inline int os_thread_create(os_thread_t *thread, const char *, os_thread_prio_t, os_thread_return_t (*)(void *), void *, size_t) { *thread = (void *)&hostSemaphoreGiven; return 0; }
+inline bool os_thread_is_current(os_thread_t) { return false; }
+
+#endif /* _PARTICLE_HOST_H */
@@ -21,6 +21,9 @@ unsigned long lastCheck = 0;
 // particularly important for DHT11 and DHT22 sensors. They do need to be valid pins, however.
 DHT22Gen3 dht(A4, A5);
 
+// Decode timing and quality for the sensor on A3
+DHTSensorDiagnostics diagnostics;
+
 int attempts = 0;
 int success = 0;
 int checksumRetries = 0;
@@ -31,6 +34,7 @@ void setup() {
 	waitFor(Serial.isConnected, 15000);
 
 	dht.setup();
+	dht.addDiagnostics(A3, &diagnostics);
 }
 
 void loop() {
@@ -48,6 +52,11 @@ void loop() {
 				Log.info("sampleResult=%d tempF=%.1f tempC=%.1f humidity=%.1f tries=%d elapsed=%lu",
 						(int) sample.getSampleResult(), sample.getTempF(), sample.getTempC(), sample.getHumidity(), sample.getTries(), elapsed);
 
+				// Per-sample timing overhead
+				DHTBackendNRF52 *backend = static_cast<DHTBackendNRF52 *>(dht.getBackend());
+				Log.info("startPulseUs=%lu captureSetupUs=%lu",
+						(unsigned long) dht.getLastStartPulseUs(), (unsigned long) backend->getLastCaptureSetupUs());
+
 				success++;
 			}
 			else {
@@ -57,6 +66,15 @@ void loop() {
 
 			int successPct = success * 100 / attempts;
 			Log.info("success=%d attempts=%d successPct=%d checksumRetries=%d", success, attempts, successPct, checksumRetries);
+
+			// Margin is how many samples a bit could change by before it's decoded incorrectly
+			const DHTFrameDiagnostics &frame = diagnostics.lastFrame;
+			Log.info("pairs=%d margin=%d-%d zeroUs=%lu-%lu oneUs=%lu-%lu startLowUs=%lu startHighUs=%lu worstMargin=%d",
+					frame.pairs, frame.minMargin, frame.maxMargin,
+					(unsigned long) frame.toMicros(frame.minZeroWidth), (unsigned long) frame.toMicros(frame.maxZeroWidth),
+					(unsigned long) frame.toMicros(frame.minOneWidth), (unsigned long) frame.toMicros(frame.maxOneWidth),
+					(unsigned long) frame.toMicros(frame.startLowWidth), (unsigned long) frame.toMicros(frame.startHighWidth),
+					diagnostics.worstMargin);
 		});
 	}
 
@@ -0,0 +1,180 @@
+// Benchmark for the DHT11/DHT22 bit decoder
+//
+// Feeds synthetic 46-word, 128 kHz I2S captures (DHT22 and DHT11 timing, jittered edges, truncated frames)
+// through DHTDecoder and the original bit-at-a-time decoder and reports the time per frame,
+// frames per second, and decode accuracy for each.
+//
+// This runs on a device like the other examples (results are logged to USB serial), but since
+// DHTDecoder and DHTCaptureSynth don't depend on Particle.h it can also be built and run on a
+// Linux or Mac computer from the top of the library:
+//
+//   g++ -O2 -Isrc examples/5-decode-benchmark/5-decode-benchmark.cpp src/DHTDecoder.cpp src/DHTCaptureSynth.cpp -o decode-benchmark
+//   ./decode-benchmark
+//
+// To benchmark a recorded capture from a real sensor, log the 46 words of the capture buffer as hex
+// and add them as another case in runBenchmarks() using runCase() with your own frames.
+
+#include "DHTDecoder.h"
+#include "DHTCaptureSynth.h"
+
+#include <string.h>
+
+#ifdef PARTICLE
+#include "Particle.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+#define BENCH_LOG(...) Log.info(__VA_ARGS__)
+
+static uint32_t benchMicros() { return micros(); }
+#else
+#include <chrono>
+#include <stdio.h>
+
+#define BENCH_LOG(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+
+static uint32_t benchMicros() {
+	return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+const size_t NUM_WORDS = 46;	// Same as the I2S capture buffer in DHT22Gen3 (DHTCaptureConfig::CONFIG_128K)
+const size_t NUM_FRAMES = 16;	// Different frames per case
+const int ITERATIONS = 200;		// Times through all frames when timing
+const int ONE_BIT_THRESHOLD = 6;	// Threshold of the built-in sensor types at 128 kHz
+
+static uint16_t frames[NUM_FRAMES][NUM_WORDS];
+static uint8_t expected[NUM_FRAMES][5];
+
+typedef int (*DecodeFn)(const uint16_t *words, size_t numWords, int oneBitThreshold, uint8_t *bytes);
+
+// This is the decoder from version 0.0.4 of the library, for comparison
+static int decodeBitwise(const uint16_t *words, size_t numWords, int oneBitThreshold, uint8_t *bytes) {
+	bool prev = true;
+	int count = 0;
+	int pair = -2;
+	memset(bytes, 0, 5);
+
+	for(size_t ii = 0; ii < numWords; ii++) {
+		uint16_t value = words[ii];
+		for(int bit = 15; bit >= 0; bit--) {
+			bool bitValue = ((value & (1 << bit)) != 0);
+			if (bitValue == prev) {
+				count++;
+			}
+			else {
+				if (prev == 1) {
+					if (pair >= 0 && pair < 40) {
+						if (count > oneBitThreshold) {
+							bytes[pair / 8] |= 1 << (7 - (pair % 8));
+						}
+					}
+					pair++;
+				}
+				count = 1;
+				prev = bitValue;
+			}
+		}
+	}
+	return pair;
+}
+
+static void makeFrames(bool dht11, uint16_t jitterUs, int numBits, uint32_t seed) {
+	DHTCaptureSynth synth;
+	synth.withTiming(dht11 ? DHTCaptureSynth::TIMING_DHT11 : DHTCaptureSynth::TIMING_DHT22)
+		.withJitter(jitterUs)
+		.withNumBits(numBits)
+		.withSeed(seed);
+
+	for(size_t ii = 0; ii < NUM_FRAMES; ii++) {
+		if (dht11) {
+			DHTCaptureSynth::makeBytesDHT11((int)(ii * 3) % 50, 20 + (int)(ii * 7) % 70, expected[ii]);
+		}
+		else {
+			DHTCaptureSynth::makeBytesDHT22((int)(ii * 97) % 1200 - 400, (int)(ii * 61) % 1000, expected[ii]);
+		}
+		synth.generate(expected[ii], frames[ii], NUM_WORDS);
+	}
+}
+
+// Complete frames are accurate if all 40 bits are found and match what was sent. Truncated
+// frames are accurate if the decoder reports fewer than 40 bits, so the library would retry.
+static void runCase(const char *name, const char *decoderName, DecodeFn decode, bool truncated) {
+	int accurate = 0;
+	uint8_t bytes[5];
+
+	for(size_t ii = 0; ii < NUM_FRAMES; ii++) {
+		int pairs = decode(frames[ii], NUM_WORDS, ONE_BIT_THRESHOLD, bytes);
+		if (truncated) {
+			if (pairs < 40) {
+				accurate++;
+			}
+		}
+		else {
+			if (pairs == 40 && memcmp(bytes, expected[ii], 5) == 0) {
+				accurate++;
+			}
+		}
+	}
+
+	volatile int sink = 0;
+	uint32_t start = benchMicros();
+	for(int iter = 0; iter < ITERATIONS; iter++) {
+		for(size_t ii = 0; ii < NUM_FRAMES; ii++) {
+			sink += decode(frames[ii], NUM_WORDS, ONE_BIT_THRESHOLD, bytes);
+		}
+	}
+	uint32_t elapsedUs = benchMicros() - start;
+	(void)sink;
+
+	unsigned long numDecoded = (unsigned long)ITERATIONS * NUM_FRAMES;
+	unsigned long nsPerFrame = (unsigned long)((uint64_t)elapsedUs * 1000 / numDecoded);
+	unsigned long framesPerSec = elapsedUs ? (unsigned long)((uint64_t)numDecoded * 1000000 / elapsedUs) : 0;
+
+	BENCH_LOG("%-22s %-8s ns/frame=%8lu frames/sec=%9lu accuracy=%d/%d",
+			name, decoderName, nsPerFrame, framesPerSec, accurate, (int)NUM_FRAMES);
+}
+
+static void runBoth(const char *name, bool truncated) {
+	runCase(name, "bitwise", decodeBitwise, truncated);
+	runCase(name, "word", DHTDecoder::decode, truncated);
+}
+
+static void runBenchmarks() {
+	makeFrames(false, 0, 40, 1);
+	runBoth("DHT22 nominal", false);
+
+	makeFrames(true, 0, 40, 2);
+	runBoth("DHT11 nominal", false);
+
+	makeFrames(false, 5, 40, 3);
+	runBoth("DHT22 jitter 5us", false);
+
+	makeFrames(false, 10, 40, 4);
+	runBoth("DHT22 jitter 10us", false);
+
+	makeFrames(true, 10, 40, 5);
+	runBoth("DHT11 jitter 10us", false);
+
+	makeFrames(false, 0, 23, 6);
+	runBoth("DHT22 truncated", true);
+}
+
+#ifdef PARTICLE
+void setup() {
+	waitFor(Serial.isConnected, 15000);
+	delay(1000);
+
+	runBenchmarks();
+}
+
+void loop() {
+}
+#else
+int main() {
+	runBenchmarks();
+	return 0;
+}
+#endif
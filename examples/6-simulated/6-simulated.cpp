@@ -0,0 +1,72 @@
+// Example that runs the library against the simulated backend
+//
+// No sensors are required. Eight simulated DHT22 sensors on D2 - D9 are read continuously and
+// the number of samples per second (real time) and per simulated second is logged. Some frames
+// are truncated to exercise the retry logic.
+//
+// This is useful for testing changes to queueing, retry, and latency without hardware.
+
+#include "DHT22Gen3_RK.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+const pin_t sensorPins[] = { D2, D3, D4, D5, D6, D7, D8, D9 };
+const size_t NUM_SENSORS = sizeof(sensorPins) / sizeof(sensorPins[0]);
+
+const unsigned long REPORT_INTERVAL = 5000;
+unsigned long lastReport = 0;
+
+DHTBackendSimulated simulatedBackend;
+DHT22Gen3 dht(&simulatedBackend);
+
+int success = 0;
+int failure = 0;
+int retries = 0;
+int outstanding = 0;
+unsigned long lastSimulatedMillis = 0;
+
+void setup() {
+	for(size_t ii = 0; ii < NUM_SENSORS; ii++) {
+		simulatedBackend.withSensor(sensorPins[ii], 200 + (int)ii * 10, 400 + (int)ii * 25);
+	}
+	simulatedBackend.withJitter(5).withTruncatePercent(2);
+
+	dht.setup();
+}
+
+void loop() {
+	// Run the state machine many times per loop so the simulated clock advances quickly
+	for(int ii = 0; ii < 1000; ii++) {
+		dht.loop();
+
+		if (outstanding == 0) {
+			// Start a sweep of all sensors
+			for(size_t jj = 0; jj < NUM_SENSORS; jj++) {
+				outstanding++;
+				dht.getSample(sensorPins[jj], [](DHTSample sample) {
+					if (sample.isSuccess()) {
+						success++;
+					}
+					else {
+						failure++;
+					}
+					retries += sample.getTries() - 1;
+					outstanding--;
+				});
+			}
+		}
+	}
+
+	if (millis() - lastReport >= REPORT_INTERVAL) {
+		unsigned long simulatedMillis = simulatedBackend.getSimulatedMicros() / 1000;
+
+		Log.info("success=%d failure=%d retries=%d samples/sec=%lu simulatedElapsed=%lu ms",
+				success, failure, retries, (unsigned long)success * 1000 / (millis() - lastReport), simulatedMillis - lastSimulatedMillis);
+
+		lastReport = millis();
+		lastSimulatedMillis = simulatedMillis;
+		success = failure = retries = 0;
+	}
+}
@@ -0,0 +1,93 @@
+// Checks that getSample() does not use the heap
+//
+// Runs 10,000 requests against the simulated backend (no sensors required), using completion
+// lambdas that capture variables, which a std::function may store on the heap. The free memory is
+// checked after every completion and the minimum and maximum are logged. They should be the same.
+//
+// The completion is a DHTCompletion, which stores the lambda inside itself and is trivially
+// copyable, so queue entries can't own heap memory. This is also checked at compile time below.
+
+#include "DHT22Gen3_RK.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+// Don't connect to the cloud, which uses the heap from the system thread
+SYSTEM_MODE(SEMI_AUTOMATIC);
+
+static_assert(std::is_trivially_copyable<DHTCompletion>::value, "DHTCompletion must be trivially copyable");
+
+const pin_t sensorPins[] = { D2, D3, D4, D5 };
+const size_t NUM_SENSORS = sizeof(sensorPins) / sizeof(sensorPins[0]);
+const int NUM_REQUESTS = 10000;
+
+DHTBackendSimulated simulatedBackend;
+DHT22Gen3 dht(&simulatedBackend);
+
+class Counter {
+public:
+	int success = 0;
+	int failure = 0;
+	int outstanding = 0;
+	uint32_t minFree = 0xffffffff;
+	uint32_t maxFree = 0;
+};
+
+Counter counter;
+int requests = 0;
+bool done = false;
+
+void setup() {
+	waitFor(Serial.isConnected, 10000);
+	delay(1000);
+
+	for(size_t ii = 0; ii < NUM_SENSORS; ii++) {
+		simulatedBackend.withSensor(sensorPins[ii], 200 + (int)ii * 10, 400 + (int)ii * 25);
+	}
+	dht.setup();
+}
+
+void loop() {
+	if (done) {
+		return;
+	}
+
+	for(int ii = 0; ii < 1000; ii++) {
+		dht.loop();
+
+		if (counter.outstanding == 0 && requests < NUM_REQUESTS) {
+			for(size_t jj = 0; jj < NUM_SENSORS; jj++) {
+				Counter *pCounter = &counter;
+				size_t sensorIndex = jj;
+
+				counter.outstanding++;
+				requests++;
+				dht.getSample(sensorPins[jj], [pCounter, sensorIndex](const DHTSample &sample) {
+					if (sample.isSuccess() && (int)(sample.getTempC() * 10 + 0.5) == 200 + (int)sensorIndex * 10) {
+						pCounter->success++;
+					}
+					else {
+						pCounter->failure++;
+					}
+					pCounter->outstanding--;
+
+					uint32_t freeMem = System.freeMemory();
+					if (freeMem < pCounter->minFree) {
+						pCounter->minFree = freeMem;
+					}
+					if (freeMem > pCounter->maxFree) {
+						pCounter->maxFree = freeMem;
+					}
+				});
+			}
+		}
+	}
+
+	if (requests >= NUM_REQUESTS && counter.outstanding == 0) {
+		Log.info("requests=%d success=%d failure=%d minFree=%lu maxFree=%lu %s",
+				requests, counter.success, counter.failure, counter.minFree, counter.maxFree,
+				(counter.minFree == counter.maxFree) ? "no heap use" : "HEAP USED");
+		done = true;
+	}
+}
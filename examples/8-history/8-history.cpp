@@ -0,0 +1,83 @@
+// Example that samples every 30 seconds and publishes the samples in batches every 5 minutes
+//
+// The samples are stored in a DHTHistory attached to the sensor, so the completion handler does
+// not need to do anything. The samples are published using the compact binary format of
+// DHTBatchEncoder (base64 encoded), which takes about 4 bytes per sample instead of about 40 for
+// JSON. Decode it on the server with DHTBatchDecoder; see the 10-batch-encoding example.
+
+#include "DHT22Gen3_RK.h"
+#include "DHTBatch.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+// How often to sample the sensor in milliseconds
+const unsigned long SAMPLE_INTERVAL = 30000;
+
+// How often to publish the stored samples in milliseconds
+const unsigned long PUBLISH_INTERVAL = 5 * 60 * 1000;
+unsigned long lastPublish = 0;
+
+// Maximum size of the publish data, including the null terminator
+const size_t PUBLISH_SIZE = 622;
+
+// The two parameters are any available GPIO pins. They will be used as output but the signals aren't
+// particularly important for DHT11 and DHT22 sensors. They do need to be valid pins, however.
+DHT22Gen3 dht(A4, A5);
+
+// Room for 20 samples, so the samples are kept if one publish fails
+DHTHistoryBuffer<20> history;
+
+void publishHistory();
+
+void setup() {
+	dht.setup();
+
+	dht.addHistory(A3, &history);
+	dht.addPeriodicSample(A3, SAMPLE_INTERVAL, nullptr);
+}
+
+void loop() {
+	dht.loop();
+
+	if (millis() - lastPublish >= PUBLISH_INTERVAL) {
+		lastPublish = millis();
+		publishHistory();
+	}
+}
+
+void publishHistory() {
+	if (!Particle.connected() || !Time.isValid() || history.isEmpty()) {
+		return;
+	}
+
+	// Only remove the records from the history once they have been published
+	DHTHistoryRecord records[20];
+	size_t numRecords = history.peek(records, sizeof(records) / sizeof(records[0]));
+
+	uint8_t binary[DHTBatchEncoder::getMaxBinarySize(PUBLISH_SIZE)];
+	DHTBatchEncoder encoder(binary, sizeof(binary));
+
+	// Convert the millis() value of each record to a Unix time
+	uint32_t now = (uint32_t)Time.now();
+	uint32_t nowMs = millis();
+	size_t numEncoded = 0;
+	for(; numEncoded < numRecords; numEncoded++) {
+		const DHTHistoryRecord &record = records[numEncoded];
+		if (!encoder.add(now - (nowMs - record.timeMs) / 1000, record.sample.getTempDeciC(), record.sample.getHumidityDeci())) {
+			break;
+		}
+	}
+
+	char buf[PUBLISH_SIZE];
+	encoder.encodeBase64(buf, sizeof(buf));
+
+	if (Particle.publish("temperatureHistory", buf, PRIVATE)) {
+		history.discard(numEncoded);
+		Log.info("published %u samples: %s", numEncoded, buf);
+	}
+	else {
+		Log.info("publish failed, keeping %u samples", history.getCount());
+	}
+}
@@ -0,0 +1,162 @@
+// Checks DHTRunningStats against a double precision reference calculation
+//
+// Feeds several sequences of values (constant, slow drift, noise, steps, large offsets) through
+// DHTRunningStats and through a straightforward two-pass double precision calculation that
+// keeps all of the values, and reports the largest difference for each statistic.
+//
+// This runs on a device like the other examples (results are logged to USB serial), but since
+// DHTStats doesn't depend on Particle.h it can also be built and run on a Linux or Mac computer
+// from the top of the library:
+//
+//   g++ -O2 -Isrc examples/9-stats/9-stats.cpp src/DHTStats.cpp -o stats-check
+//   ./stats-check
+//
+// The program exits with a non-zero status on the host if any difference is out of tolerance.
+
+#include "DHTStats.h"
+
+#include <math.h>
+
+#ifdef PARTICLE
+#include "Particle.h"
+
+SerialLogHandler logHandler;
+
+SYSTEM_THREAD(ENABLED);
+
+#define STATS_LOG(...) Log.info(__VA_ARGS__)
+#else
+#include <stdio.h>
+
+#define STATS_LOG(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#endif
+
+const size_t MAX_VALUES = 5000;
+const float EWMA_ALPHA = 0.1f;
+const uint16_t WINDOW_SIZE = 30;
+
+static int16_t values[MAX_VALUES];
+static uint32_t seed = 1;
+static int failures = 0;
+
+static uint32_t nextRandom() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// Returns the difference and counts a failure if it's larger than tolerance
+static double check(double actual, double expected, double tolerance) {
+	double diff = fabs(actual - expected);
+	if (diff > tolerance) {
+		failures++;
+	}
+	return diff;
+}
+
+static void runCase(const char *name, size_t numValues) {
+	DHTRunningStats stats;
+	stats.withEwmaAlpha(EWMA_ALPHA).withWindowSize(WINDOW_SIZE);
+
+	double maxEwmaDiff = 0;
+	double ewma = 0;
+
+	for(size_t ii = 0; ii < numValues; ii++) {
+		stats.add(values[ii]);
+
+		ewma = (ii == 0) ? values[ii] : ewma + (double)EWMA_ALPHA * (values[ii] - ewma);
+		double diff = check(stats.getEwma(), ewma, 1.0);
+		if (diff > maxEwmaDiff) {
+			maxEwmaDiff = diff;
+		}
+	}
+
+	// Two-pass reference
+	double sum = 0;
+	int16_t min = values[0], max = values[0];
+	for(size_t ii = 0; ii < numValues; ii++) {
+		sum += values[ii];
+		if (values[ii] < min) {
+			min = values[ii];
+		}
+		if (values[ii] > max) {
+			max = values[ii];
+		}
+	}
+	double mean = sum / numValues;
+	double sumSq = 0;
+	for(size_t ii = 0; ii < numValues; ii++) {
+		sumSq += (values[ii] - mean) * (values[ii] - mean);
+	}
+	double variance = (numValues > 1) ? sumSq / (numValues - 1) : 0;
+
+	size_t windowStart = (numValues / WINDOW_SIZE - 1) * WINDOW_SIZE;
+	double windowSum = 0;
+	for(size_t ii = windowStart; ii < windowStart + WINDOW_SIZE; ii++) {
+		windowSum += values[ii];
+	}
+	double windowMean = windowSum / WINDOW_SIZE;
+
+	check(stats.getMin(), min, 0);
+	check(stats.getMax(), max, 0);
+	double meanDiff = check(stats.getMean(), mean, 0.5);
+	double varianceDiff = check(stats.getVariance(), variance, 0.001 * variance + 0.01);
+	double stdDevDiff = check(stats.getStdDev(), sqrt(variance), 0.001 * sqrt(variance) + 0.01);
+	double windowDiff = check(stats.getWindowMean(), windowMean, 0.5);
+
+	STATS_LOG("%-16s n=%4u mean=%8.2f (diff %.3f) stdDev=%8.3f (diff %.5f) variance diff %.5f ewma diff %.3f window diff %.3f",
+			name, (unsigned)numValues, mean, meanDiff, sqrt(variance), stdDevDiff, varianceDiff, maxEwmaDiff, windowDiff);
+}
+
+static void runChecks() {
+	// Values are in tenths, like the temperature and humidity from DHT22Gen3
+	for(size_t ii = 0; ii < MAX_VALUES; ii++) {
+		values[ii] = 215;
+	}
+	runCase("constant", MAX_VALUES);
+
+	for(size_t ii = 0; ii < MAX_VALUES; ii++) {
+		values[ii] = (int16_t)(-400 + (int)(ii * 1200 / MAX_VALUES));
+	}
+	runCase("drift", MAX_VALUES);
+
+	for(size_t ii = 0; ii < MAX_VALUES; ii++) {
+		values[ii] = (int16_t)(450 + (int)(nextRandom() % 41) - 20);
+	}
+	runCase("noise", MAX_VALUES);
+
+	for(size_t ii = 0; ii < MAX_VALUES; ii++) {
+		values[ii] = (int16_t)(((ii / 500) % 2) ? 800 : -400);
+	}
+	runCase("steps", MAX_VALUES);
+
+	for(size_t ii = 0; ii < MAX_VALUES; ii++) {
+		values[ii] = (int16_t)(32000 + (int)(nextRandom() % 11) - 5);
+	}
+	runCase("large offset", MAX_VALUES);
+
+	for(size_t ii = 0; ii < 60; ii++) {
+		values[ii] = (int16_t)(nextRandom() % 1001);
+	}
+	runCase("short", 60);
+
+	STATS_LOG("%s (%d failures)", failures ? "FAILED" : "passed", failures);
+}
+
+#ifdef PARTICLE
+void setup() {
+	waitFor(Serial.isConnected, 15000);
+	delay(1000);
+
+	runChecks();
+}
+
+void loop() {
+}
+#else
+int main() {
+	runChecks();
+	return failures ? 1 : 0;
+}
+#endif
@@ -1,86 +1,179 @@
 #include "DHT22Gen3_RK.h"
+#include "DHTDecoder.h"
 
 // Repository: https://github.com/rickkas7/DHT22Gen3_RK
 // License: MIT
 
-// Must undefine this or the direct nRF52 libraries won't compile as there is a struct member SCK
-#undef SCK
+// Needed for logf() to calculate dewpoint.
+#include <math.h>
 
-#include "nrf_gpio.h"
-#include "nrfx_i2s.h"
+// Maximum time to wait for the capture to complete after the start pulse
+static const unsigned long CAPTURE_TIMEOUT_MS = 15;
 
-// Needed for log() to calculate dewpoint.
-#include <math.h>
+// Minimum time between the first samples of periodic sensors. A DHT11 sample normally takes 24 ms.
+static const unsigned long PERIODIC_SPACING_MS = 50;
 
-static const size_t NUM_SAMPLES = 180;
-static volatile int buffersRequested = 0;
-static uint16_t sampleBuffer[NUM_SAMPLES];
-static nrfx_i2s_buffers_t i2sBuffer = {
-		.p_rx_buffer = (uint32_t *)sampleBuffer,
-		.p_tx_buffer = 0
-};
+// 63 * 32 = 2016 bits per 32 MHz, 508 kHz, 180 words is 5.67 ms
+const DHTCaptureConfig DHTCaptureConfig::CONFIG_512K = { 63, 32, 180 };
+
+// 125 * 64 = 8000 bits per 32 MHz, 128 kHz, 46 words is 5.75 ms
+const DHTCaptureConfig DHTCaptureConfig::CONFIG_128K = { 125, 64, 46 };
+
+DHTSensorType *DHTSensorType::sensorTypes[NUM_TYPE_TAGS];
 
 DHTSensorTypeDHT11 DHT22Gen3::sensorTypeDHT11;
 DHTSensorTypeDHT22 DHT22Gen3::sensorTypeDHT22;
 
+constexpr uint8_t DHTTraitsDHT11::typeTag;
+constexpr unsigned long DHTTraitsDHT11::minSamplePeriodMs;
+constexpr int DHTTraitsDHT11::oneBitThreshold;
+constexpr int DHTTraitsDHT11::oneBitThresholdUs;
+constexpr uint32_t DHTTraitsDHT11::startPulseUs;
+constexpr uint8_t DHTTraitsDHT22::typeTag;
+constexpr unsigned long DHTTraitsDHT22::minSamplePeriodMs;
+constexpr int DHTTraitsDHT22::oneBitThreshold;
+constexpr int DHTTraitsDHT22::oneBitThresholdUs;
+constexpr uint32_t DHTTraitsDHT22::startPulseUs;
+
+// The conversions are evaluated at compile time
+static constexpr uint8_t testBytesDHT22[5] = { 0x02, 0x8c, 0x80, 0x65, 0x73 };
+static constexpr uint8_t testBytesDHT11[5] = { 0x2d, 0x00, 0x17, 0x00, 0x44 };
+static_assert(DHTTraitsDHT22::getTempDeciC(testBytesDHT22) == -101, "DHT22 temperature conversion");
+static_assert(DHTTraitsDHT22::getHumidityDeci(testBytesDHT22) == 652, "DHT22 humidity conversion");
+static_assert(DHTTraitsDHT11::getTempDeciC(testBytesDHT11) == 230, "DHT11 temperature conversion");
+static_assert(DHTTraitsDHT11::getHumidityDeci(testBytesDHT11) == 450, "DHT11 humidity conversion");
+static_assert(DHTSample::deciCToDeciF(215) == 707 && DHTSample::deciCToDeciF(-400) == -400, "Fahrenheit conversion");
+
+// log2(1 + i / 16) for i = 0 to 16, scaled by 65536 (the last entry is 65535 so it fits)
+static const uint16_t log2Table[17] = { 0, 5732, 11136, 16248, 21098, 25711, 30109, 34312, 38336, 42196, 45904, 49472, 52911, 56229, 59434, 62534, 65535 };
+
+// Constants for the fixed point dew point calculation, scaled by 4096 (Q12)
+static const int32_t DEW_POINT_A_Q12 = 70742;		// 17.271
+static const int32_t DEW_POINT_LN1000_Q12 = 28294;	// ln(1000), to convert tenths of a percent to a fraction
+static const uint32_t LN2_Q12 = 2839;				// ln(2)
+static const int32_t DEW_POINT_B_DECI = 2377;		// 237.7 C in tenths of a degree
+
+// Natural log of x in Q12, for x >= 1
+static int32_t lnQ12(uint32_t x) {
+	int exponent = 31 - __builtin_clz(x);
+
+	// Normalize so the most significant bit is bit 31, then the next 4 bits select the table
+	// entry and the 16 bits below those are used to interpolate
+	uint32_t mantissa = x << (31 - exponent);
+	uint32_t index = (mantissa >> 27) & 0xf;
+	uint32_t fraction = (mantissa >> 11) & 0xffff;
+
+	uint32_t log2Q16 = ((uint32_t)exponent << 16) + log2Table[index] + (((uint32_t)(log2Table[index + 1] - log2Table[index]) * fraction) >> 16);
+
+	return (int32_t)((log2Q16 * LN2_Q12 + 32768) >> 16);
+}
+
+// [static]
+DHTSensorType *DHTTraitsDHT11::getSensorType() {
+	return &DHT22Gen3::sensorTypeDHT11;
+}
+
+// [static]
+DHTSensorType *DHTTraitsDHT22::getSensorType() {
+	return &DHT22Gen3::sensorTypeDHT22;
+}
 
-static float combineBytes(uint8_t highByte, uint8_t lowByte) {
-	return (float) ((((uint16_t)highByte) << 8) | lowByte);
+//
+// Sensor type base class
+//
+DHTSensorType::DHTSensorType(uint8_t typeTag, const char *name, unsigned long minSamplePeriodMs, unsigned long oneBitThreshold, const DHTCaptureConfig &captureConfig) :
+		name(name), minSamplePeriodMs(minSamplePeriodMs), oneBitThreshold(oneBitThreshold), captureConfig(captureConfig), typeTag(typeTag) {
+	sensorTypes[typeTag] = this;
 }
 
-static void dataHandler(nrfx_i2s_buffers_t const *p_released, uint32_t status) {
-	if (status == NRFX_I2S_STATUS_NEXT_BUFFERS_NEEDED) {
-		buffersRequested++;
-		if (buffersRequested >= 2) {
-			nrfx_i2s_stop();
+DHTSensorType::~DHTSensorType() {
+	if (sensorTypes[typeTag] == this) {
+		sensorTypes[typeTag] = 0;
+	}
+}
+
+// [static]
+uint8_t DHTSensorType::registerType(DHTSensorType *sensorType) {
+	// Tags below TYPE_TAG_DHT22 + 1 are reserved for the built-in types, which are constructed
+	// during static initialization in an unknown order relative to custom types
+	for(uint8_t tag = TYPE_TAG_DHT22 + 1; tag < NUM_TYPE_TAGS; tag++) {
+		if (!sensorTypes[tag]) {
+			sensorTypes[tag] = sensorType;
+			return tag;
 		}
 	}
+	return TYPE_TAG_NONE;
+}
+
+// [static]
+unsigned long DHTSensorType::scaleThreshold(unsigned long threshold, const DHTCaptureConfig &from, const DHTCaptureConfig &to) {
+	uint32_t fromRate = from.getSampleRate();
+	return (unsigned long)(((uint64_t)threshold * to.getSampleRate() + fromRate / 2) / fromRate);
+}
+
+int16_t DHTSensorType::getTempDeciC(const DHTSample &sample) const {
+	return (int16_t)lroundf(getTempC(sample) * 10);
+}
+
+int16_t DHTSensorType::getHumidityDeci(const DHTSample &sample) const {
+	return (int16_t)lroundf(getHumidity(sample) * 10);
 }
 
 //
 // Sensor type decoders
 //
-DHTSensorTypeDHT11::DHTSensorTypeDHT11() : DHTSensorType("DHT11", 1000, 25) {
-
+DHTSensorTypeDHT11::DHTSensorTypeDHT11() : DHTSensorType(DHTTraitsDHT11::typeTag, DHTTraitsDHT11::getName(), DHTTraitsDHT11::minSamplePeriodMs, DHTTraitsDHT11::oneBitThreshold, DHTCaptureConfig::CONFIG_128K) {
+	oneBitThresholdUs = DHTTraitsDHT11::oneBitThresholdUs;
+	startPulseUs = DHTTraitsDHT11::startPulseUs;
 };
 
 float DHTSensorTypeDHT11::getTempC(const DHTSample &sample) const {
-	return (float) ((int8_t) sample[2]);
+	return DHTTraitsDHT11::getTempC(sample.getBytes());
 }
 
 float DHTSensorTypeDHT11::getHumidity(const DHTSample &sample) const {
-	return (float) ((int8_t) sample[0]);
+	return DHTTraitsDHT11::getHumidity(sample.getBytes());
 }
 
+int16_t DHTSensorTypeDHT11::getTempDeciC(const DHTSample &sample) const {
+	return DHTTraitsDHT11::getTempDeciC(sample.getBytes());
+}
+
+int16_t DHTSensorTypeDHT11::getHumidityDeci(const DHTSample &sample) const {
+	return DHTTraitsDHT11::getHumidityDeci(sample.getBytes());
+}
 
-DHTSensorTypeDHT22::DHTSensorTypeDHT22() : DHTSensorType("DHT22", 2000, 25) {
 
+DHTSensorTypeDHT22::DHTSensorTypeDHT22() : DHTSensorType(DHTTraitsDHT22::typeTag, DHTTraitsDHT22::getName(), DHTTraitsDHT22::minSamplePeriodMs, DHTTraitsDHT22::oneBitThreshold, DHTCaptureConfig::CONFIG_128K) {
+	oneBitThresholdUs = DHTTraitsDHT22::oneBitThresholdUs;
+	startPulseUs = DHTTraitsDHT22::startPulseUs;
 };
 
 float DHTSensorTypeDHT22::getTempC(const DHTSample &sample) const {
-	return (sample[2] & 0x80 ? -combineBytes(sample[2] & 0x7F, sample[3]) : combineBytes(sample[2], sample[3])) * 0.1;
-
+	return DHTTraitsDHT22::getTempC(sample.getBytes());
 }
 
 float DHTSensorTypeDHT22::getHumidity(const DHTSample &sample) const {
-	return combineBytes(sample[0], sample[1]) * 0.1;
+	return DHTTraitsDHT22::getHumidity(sample.getBytes());
 }
 
-//
-// Sample result container
-//
-DHTSample::DHTSample() {
-
+int16_t DHTSensorTypeDHT22::getTempDeciC(const DHTSample &sample) const {
+	return DHTTraitsDHT22::getTempDeciC(sample.getBytes());
 }
 
-DHTSample::~DHTSample() {
-
+int16_t DHTSensorTypeDHT22::getHumidityDeci(const DHTSample &sample) const {
+	return DHTTraitsDHT22::getHumidityDeci(sample.getBytes());
 }
 
+//
+// Sample result container
+//
 void DHTSample::clear() {
 	sampleResult = SampleResult::ERROR;
-	bytes[5] = {0};
+	memset(bytes, 0, sizeof(bytes));
 	tries = 0;
+	repaired = 0;
+	repairMargin = 0;
 }
 
 
@@ -91,42 +184,183 @@ bool DHTSample::isValidChecksum() const {
 
 
 float DHTSample::getTempC() const {
-	return sensorType->getTempC(*this);
+	// The built-in types are converted inline instead of through the virtual function
+	switch(typeTag) {
+	case DHTSensorType::TYPE_TAG_DHT11:
+		return DHTTraitsDHT11::getTempC(bytes);
+
+	case DHTSensorType::TYPE_TAG_DHT22:
+		return DHTTraitsDHT22::getTempC(bytes);
+
+	default:
+		break;
+	}
+	const DHTSensorType *sensorType = getSensorType();
+	return sensorType ? sensorType->getTempC(*this) : NAN;
 }
 
 float DHTSample::getTempF() const {
 
-	return (getTempC() * 9) / 5 + 32.0;
+	return (getTempC() * 9) / 5 + 32.0f;
 }
 
 
 float DHTSample::getHumidity() const {
-	return sensorType->getHumidity(*this);
+	switch(typeTag) {
+	case DHTSensorType::TYPE_TAG_DHT11:
+		return DHTTraitsDHT11::getHumidity(bytes);
+
+	case DHTSensorType::TYPE_TAG_DHT22:
+		return DHTTraitsDHT22::getHumidity(bytes);
+
+	default:
+		break;
+	}
+	const DHTSensorType *sensorType = getSensorType();
+	return sensorType ? sensorType->getHumidity(*this) : NAN;
 }
 
 float DHTSample::getDewPointC() const {
 	// http://en.wikipedia.org/wiki/Dew_point
 
-	double temp = (double) getTempC();
+	float temp = getTempC();
 
-	double a = 17.271;
-	double b = 237.7;
-	double adjTemp = (a * temp) / (b + temp) + log(getHumidity() / 100.0);
-	double Td = (b * adjTemp) / (a - adjTemp);
+	float a = 17.271f;
+	float b = 237.7f;
+	float adjTemp = (a * temp) / (b + temp) + logf(getHumidity() / 100.0f);
+	float Td = (b * adjTemp) / (a - adjTemp);
 
 	return Td;
 }
 
 
 float DHTSample::getDewPointF() const {
-	return (getDewPointC() * 9) / 5 + 32.0;
+	return (getDewPointC() * 9) / 5 + 32.0f;
+}
+
+int16_t DHTSample::getTempDeciC() const {
+	switch(typeTag) {
+	case DHTSensorType::TYPE_TAG_DHT11:
+		return DHTTraitsDHT11::getTempDeciC(bytes);
+
+	case DHTSensorType::TYPE_TAG_DHT22:
+		return DHTTraitsDHT22::getTempDeciC(bytes);
+
+	default:
+		break;
+	}
+	const DHTSensorType *sensorType = getSensorType();
+	return sensorType ? sensorType->getTempDeciC(*this) : 0;
+}
+
+int16_t DHTSample::getHumidityDeci() const {
+	switch(typeTag) {
+	case DHTSensorType::TYPE_TAG_DHT11:
+		return DHTTraitsDHT11::getHumidityDeci(bytes);
+
+	case DHTSensorType::TYPE_TAG_DHT22:
+		return DHTTraitsDHT22::getHumidityDeci(bytes);
+
+	default:
+		break;
+	}
+	const DHTSensorType *sensorType = getSensorType();
+	return sensorType ? sensorType->getHumidityDeci(*this) : 0;
+}
+
+// [static]
+int16_t DHTSample::calculateDewPointDeciC(int tempDeciC, int humidityDeci) {
+	// Same formula as getDewPointC(), in Q12 fixed point
+	if (tempDeciC < -400) {
+		tempDeciC = -400;
+	}
+	if (tempDeciC > 800) {
+		tempDeciC = 800;
+	}
+	if (humidityDeci < 1) {
+		humidityDeci = 1;
+	}
+	if (humidityDeci > 1000) {
+		humidityDeci = 1000;
+	}
+
+	// a * T / (b + T) + ln(RH / 100). T and b are both in tenths, so the scale cancels.
+	int32_t adjTemp = (DEW_POINT_A_Q12 * tempDeciC) / (DEW_POINT_B_DECI + tempDeciC) + lnQ12((uint32_t)humidityDeci) - DEW_POINT_LN1000_Q12;
+
+	// b * adjTemp / (a - adjTemp), rounded to the nearest tenth
+	int32_t num = DEW_POINT_B_DECI * adjTemp;
+	int32_t den = DEW_POINT_A_Q12 - adjTemp;
+	return (int16_t)((num + ((num >= 0) ? den / 2 : -den / 2)) / den);
+}
+
+//
+// Sample history
+//
+void DHTHistory::add(uint32_t timeMs, const DHTSample &sample) {
+	if (capacity == 0 || (successOnly && !sample.isSuccess())) {
+		return;
+	}
+
+	if (count >= capacity) {
+		// Overwrite the oldest
+		head = (head + 1) % capacity;
+		count--;
+		droppedCount++;
+	}
+
+	DHTHistoryRecord &record = records[(head + count) % capacity];
+	record.timeMs = timeMs;
+	record.sample = sample;
+	count++;
+}
+
+size_t DHTHistory::read(DHTHistoryRecord *dst, size_t maxRecords) {
+	size_t numRead = peek(dst, maxRecords);
+	discard(numRead);
+	return numRead;
+}
+
+size_t DHTHistory::peek(DHTHistoryRecord *dst, size_t maxRecords, size_t offset) const {
+	if (offset >= count) {
+		return 0;
+	}
+	size_t numRead = count - offset;
+	if (numRead > maxRecords) {
+		numRead = maxRecords;
+	}
+
+	// Copy in up to two pieces, before and after the end of the buffer
+	size_t start = (head + offset) % capacity;
+	size_t first = capacity - start;
+	if (first > numRead) {
+		first = numRead;
+	}
+	memcpy(dst, &records[start], first * sizeof(DHTHistoryRecord));
+	memcpy(&dst[first], records, (numRead - first) * sizeof(DHTHistoryRecord));
+
+	return numRead;
+}
+
+size_t DHTHistory::discard(size_t numRecords) {
+	if (numRecords > count) {
+		numRecords = count;
+	}
+	if (numRecords) {
+		head = (head + numRecords) % capacity;
+		count -= numRecords;
+	}
+	return numRecords;
 }
 
 //
 // Main class
 //
 
-DHT22Gen3::DHT22Gen3(pin_t unusedPin1, pin_t unusedPin2) : unusedPin1(unusedPin1), unusedPin2(unusedPin2) {
+DHT22Gen3::DHT22Gen3(pin_t unusedPin1, pin_t unusedPin2) : nrf52Backend(unusedPin1, unusedPin2), backend(&nrf52Backend) {
+
+}
+
+DHT22Gen3::DHT22Gen3(DHTBackend *backend) : nrf52Backend(PIN_INVALID, PIN_INVALID), backend(backend) {
 
 }
 
@@ -134,153 +368,210 @@ DHT22Gen3::~DHT22Gen3() {
 }
 
 void DHT22Gen3::setup() {
-	attachInterruptDirect(I2S_IRQn, nrfx_i2s_irq_handler, false);
+	backend->setup();
+
+	if (workerThread && !worker) {
+		if (!requestMutex) {
+			os_mutex_create(&requestMutex);
+		}
+		for(size_t ii = 0; ii < DHT22GEN3_MAX_QUEUE_DEPTH + 1; ii++) {
+			if (!waiters[ii].semaphore) {
+				os_semaphore_create(&waiters[ii].semaphore, 1, 0);
+			}
+		}
+		if (os_semaphore_create(&workerSemaphore, 1, 0) == 0) {
+			if (os_thread_create(&worker, "dht22gen3", DHT22GEN3_WORKER_PRIORITY, workerThreadFunction, this, DHT22GEN3_WORKER_STACK_SIZE) == 0) {
+				backend->setCaptureHandler(workerCaptureHandler, this);
+			}
+			else {
+				worker = 0;
+			}
+		}
+		if (!worker) {
+			Log.info("worker thread could not be created, sampling from loop");
+		}
+	}
 }
 
 void DHT22Gen3::loop() {
+	checkPeriodic();
+
+	if (!workerThread) {
+		process();
+		return;
+	}
+
+	if (!worker) {
+		// The thread could not be created, so run the worker side from here
+		process();
+	}
+
+	// Call the completions of the samples the worker thread has finished
+	Completed entry;
+	while(completedQueue.pop(entry)) {
+		pendingCount--;
+		updateAttachments(entry.dhtPin, entry.sample);
+		if (entry.completion) {
+			entry.completion(entry.sample);
+		}
+	}
+}
+
+void DHT22Gen3::process() {
+	// Requests posted by getSample() with the worker thread
+	Request req;
+	while(requestQueue.pop(req)) {
+		addRequest(req.dhtPin, req.completion, req.sensorType, req.onWorker);
+	}
+
 	switch(state) {
 	case State::IDLE_STATE:
+		startNextRequest();
 		break;
 
 	case State::START_STATE:
-		if (lastRequestTime != 0 && millis() - lastRequestTime < sensorType->minSamplePeriodMs) {
+		if (curSensor->lastRequestTime != 0 && backend->getMillis() - curSensor->lastRequestTime < sensorType->minSamplePeriodMs) {
 			// Not time to check yet, wait a bit
 			break;
 		}
 
-		result.clear();
+		// Clear the result bytes but not tries, which counts retries of this request
+		memset(result.bytes, 0, sizeof(result.bytes));
+		result.repaired = 0;
+		result.repairMargin = 0;
 
 		// Can sample now
-		pinMode(unusedPin1, OUTPUT); // SCK
-		pinMode(unusedPin2, OUTPUT); // LRCK
+		backend->prepareCapture();
+
+		if (backend->hasTimedStart()) {
+			// The backend sends the start pulse, releases the line, and starts the capture itself
+			// (from a timer interrupt) so the timing does not depend on how often loop() is called
+			if (!backend->startTimedCapture(dhtPin, sensorType->startPulseUs, sensorType->captureConfig)) {
+				callCompletion(DHTSample::SampleResult::ERROR);
+				return;
+			}
+
+			result.addTry();
+			stateTime = backend->getMillis();
+			samplingTimeoutMs = (sensorType->startPulseUs + 999) / 1000 + CAPTURE_TIMEOUT_MS;
+			startDecoder();
+			state = State::SAMPLING_STATE;
+			break;
+		}
 
 		// Because it was in INPUT mode before and there is an external pull-up it was already high
-		pinMode(dhtPin, OUTPUT);
+		backend->setPinMode(dhtPin, OUTPUT);
 
-		// Low for 18 ms
-		digitalWrite(dhtPin, LOW);
-		stateTime = millis();
+		// Low for startPulseUs (18 ms for the DHT11, about 1 ms for the DHT22)
+		backend->writePin(dhtPin, LOW);
+		startPulseMicros = backend->getMicros();
 		state = State::SEND_START_STATE;
 		break;
 
 	case State::SEND_START_STATE:
-		if (millis() - stateTime < 18) {
-			// Stay in SEND_START_STATE for 18 milliseconds
+		if (backend->getMicros() - startPulseMicros < sensorType->startPulseUs) {
+			// Stay in SEND_START_STATE until the start pulse is long enough
 			break;
 		}
 
-		{
-			// Go into input mode; the pull-up will keep it high
-			pinMode(dhtPin, INPUT);
-
-			// We let the pull-up pull the pin high again, and it should stay that way for 20-40 us then the device takes over
-			Hal_Pin_Info *pinMap =
-#if (SYSTEM_VERSION < SYSTEM_VERSION_ALPHA(5, 0, 0, 1))
-        		HAL_Pin_Map();
-#elif (SYSTEM_VERSION >= SYSTEM_VERSION_ALPHA(6, 2, 0, 0))
-        		hal_pin_map();
-#else // SYSTEM_VERSION
-        		Hal_Pin_Map();
-#endif // SYSTEM_VERSION			
-
-			nrfx_i2s_config_t config = NRFX_I2S_DEFAULT_CONFIG;
-
-			// Log.info("Got %02x Expected %02x", NRF_GPIO_PIN_MAP(pinMap[dhtPin].gpio_port, pinMap[dhtPin].gpio_pin), NRF_GPIO_PIN_MAP(0, 29));
-
-			config.sdin_pin = (uint8_t)NRF_GPIO_PIN_MAP(pinMap[dhtPin].gpio_port, pinMap[dhtPin].gpio_pin);
-			config.sck_pin = (uint8_t)NRF_GPIO_PIN_MAP(pinMap[unusedPin1].gpio_port, pinMap[unusedPin1].gpio_pin);
-			config.lrck_pin = (uint8_t)NRF_GPIO_PIN_MAP(pinMap[unusedPin2].gpio_port, pinMap[unusedPin2].gpio_pin);
-			config.mck_pin = NRFX_I2S_PIN_NOT_USED;
-			config.sdout_pin = NRFX_I2S_PIN_NOT_USED;
-
-			config.mode = NRF_I2S_MODE_MASTER;
-			config.format = NRF_I2S_FORMAT_I2S;
-			config.alignment = NRF_I2S_ALIGN_LEFT;
-			config.sample_width = NRF_I2S_SWIDTH_16BIT;
-			config.channels = NRF_I2S_CHANNELS_STEREO;
-			config.mck_setup = NRF_I2S_MCK_32MDIV63;
-			config.ratio = NRF_I2S_RATIO_32X;
-
-			// These settings are for 16,000 samples per second, 16-bit, stereo
-			// That means that we have 16,000 32-bit words per second or 512,000 bits per second
-
-			nrfx_err_t err = nrfx_i2s_init(&config, dataHandler);
-			if (err != NRFX_SUCCESS) {
-				Log.info("nrfx_i2s_init error=%lu", err);
-				callCompletion(DHTSample::SampleResult::ERROR);
-				return;
-			}
-
-			buffersRequested = 0;
+		// Go into input mode; the pull-up will keep it high
+		backend->setPinMode(dhtPin, INPUT);
+		lastStartPulseUs = backend->getMicros() - startPulseMicros;
 
-			// Sample data. The / 2 factor because the parameter is the number of 32-bit words, not number of 16-bit samples!
-			err = nrfx_i2s_start(&i2sBuffer, NUM_SAMPLES / 2, 0);
-			if (err != NRFX_SUCCESS) {
-				Log.info("nrfx_i2s_start error=%lu", err);
-				callCompletion(DHTSample::SampleResult::ERROR);
-				return;
-			}
+		if (!backend->startCapture(dhtPin, sensorType->captureConfig)) {
+			callCompletion(DHTSample::SampleResult::ERROR);
+			return;
 		}
 
-		result.tries++;
-		stateTime = millis();
+		result.addTry();
+		stateTime = backend->getMillis();
+		samplingTimeoutMs = CAPTURE_TIMEOUT_MS;
+		startDecoder();
 		state = State::SAMPLING_STATE;
 		break;
 
 	case State::SAMPLING_STATE:
-		if (buffersRequested < 2 && millis() - stateTime < 15) {
+		// Decode what has been captured so far so the capture can be stopped as soon as the
+		// frame is complete, instead of always waiting for the whole buffer. The decoder writes
+		// to the diagnostics, which removeDiagnostics() can detach from another thread.
+		lockRequests();
+		updateDecoder();
+		unlockRequests();
+		if (decoder.getPairs() < 40 && !backend->isCaptureComplete() && backend->getMillis() - stateTime < samplingTimeoutMs) {
 			// Wait for samples to complete
 			break;
 		}
 
-		// uninitialize the I2S peripheral
-		nrfx_i2s_uninit();
+		if (backend->hasTimedStart()) {
+			lastStartPulseUs = backend->getLastStartPulseUs();
+		}
 
-		if (buffersRequested < 2) {
+		if (!backend->stopCapture()) {
 			// This means the I2S peripheral is in a weird and unknown state (not related to the sensor)
 			callCompletion(DHTSample::SampleResult::ERROR);
 			return;
 		}
 
-		lastRequestTime = millis();
+		curSensor->lastRequestTime = backend->getMillis();
 
+		// Anything captured after the last check. The lock is held until the diagnostics are
+		// updated, but not while calling the completion.
+		lockRequests();
+		updateDecoder();
 
-		// Decode samples
-		bool prev = true;
-		int count = 0;
-		int pair = -2; // This is for the start sequence
-		memset(result.bytes, 0, sizeof(result.bytes));
+		// Diagnostics are only added if they were attached when the capture started
+		DHTFrameDiagnostics *frame = decoder.getDiagnostics();
+		// requestMutex is already locked, so use findAttachment() instead of getDiagnostics()
+		Attachment *attachment = frame ? findAttachment(dhtPin, false) : 0;
+		DHTSensorDiagnostics *diagnostics = attachment ? attachment->diagnostics : 0;
+		if (diagnostics && frame != &diagnostics->lastFrame) {
+			diagnostics = 0;
+		}
 
-		for(size_t ii = 0; ii < NUM_SAMPLES; ii++) {
-			uint16_t value = sampleBuffer[ii];
-			for(int bit = 15; bit >= 0; bit--) {
-				bool bitValue = ((value & (1 << bit)) != 0);
-				if (bitValue == prev) {
-					count++;
-				}
-				else {
-					// Log.info("%d bit count=%d", prev, count);
-					if (prev == 1) {
-						if (pair >= 0 && pair < 40) {
-							// Normal 0 bit is count = 13
-							// Normal 1 bit is count = 37
-							bool b = (count > sensorType->oneBitThreshold);
-
-							if (b) {
-								int byteIndex = pair / 8;
-								int bitIndex = pair % 8;
-								result.bytes[byteIndex] |= 1 << (7 - bitIndex);
-							}
-						}
-						pair++;
-					}
-
-					count = 1;
-					prev = bitValue;
+		int fixedThreshold = backend->capturesEdges() ? sensorType->oneBitThresholdUs : sensorType->oneBitThreshold;
+		int pair = decoder.getPairs();
+		memcpy(result.bytes, decoder.getBytes(), sizeof(result.bytes));
+
+		if (adaptiveThreshold && pair == 40) {
+			// A real 0 and 1 bit differ by about 43 us, so require half of the fixed threshold (48 us)
+			decoder.adaptThreshold(fixedThreshold / 2);
+			memcpy(result.bytes, decoder.getBytes(), sizeof(result.bytes));
+
+			if (!result.isValidChecksum() && decoder.getOneBitThreshold() != fixedThreshold) {
+				decoder.applyThreshold(fixedThreshold);
+				memcpy(result.bytes, decoder.getBytes(), sizeof(result.bytes));
+			}
+			if (result.isValidChecksum()) {
+				curSensor->thresholdType = sensorType;
+				curSensor->learnedThreshold = decoder.getOneBitThreshold();
+			}
+		}
+
+		if (repairMarginUs && pair == 40 && !result.isValidChecksum()) {
+			int maxMargin = repairMarginUs;
+			if (!backend->capturesEdges()) {
+				maxMargin = (int)((uint32_t)repairMarginUs * sensorType->captureConfig.getSampleRate() / 1000000);
+				if (maxMargin < 1) {
+					maxMargin = 1;
 				}
 			}
+			int margin = decoder.repairChecksum(maxMargin);
+			if (margin) {
+				Log.info("repaired checksum, margin=%d", margin);
+				memcpy(result.bytes, decoder.getBytes(), sizeof(result.bytes));
+				result.repaired = 1;
+				result.repairMargin = (uint8_t)((margin < 255) ? margin : 255);
+			}
 		}
 
+		if (diagnostics) {
+			frame->calculate();
+			// A repaired frame still counts as a checksum error in the diagnostics
+			frame->checksumValid = (pair == 40) && result.isValidChecksum() && !result.repaired;
+			diagnostics->add(*frame);
+		}
+		unlockRequests();
+
 		if (pair == 40) {
 			// Log.info("result.bytes = %02x %02x %02x %02x %02x", result.bytes[0], result.bytes[1], result.bytes[2], result.bytes[3], result.bytes[4]);
 
@@ -304,41 +595,700 @@ void DHT22Gen3::loop() {
 
 		// Corrupted data, retry
 		Log.info("retrying");
-		stateTime = millis();
+		stateTime = backend->getMillis();
 		state = State::START_STATE;
 		break;
 	}
 }
 
 
-void DHT22Gen3::getSample(pin_t dhtPin, std::function<void(DHTSample)> completion, DHTSensorType *sensorType) {
-	if (state != State::IDLE_STATE) {
+void DHT22Gen3::startDecoder() {
+	int fixedThreshold = backend->capturesEdges() ? sensorType->oneBitThresholdUs : sensorType->oneBitThreshold;
+	bool useLearned = adaptiveThreshold && curSensor->thresholdType == sensorType;
+
+	lockRequests();
+	decoder.reset(useLearned ? curSensor->learnedThreshold : fixedThreshold);
+	decodedCount = 0;
+
+	// Record the timing only if the sensor has diagnostics attached
+	Attachment *attachment = findAttachment(dhtPin, false);
+	DHTSensorDiagnostics *diagnostics = attachment ? attachment->diagnostics : 0;
+	if (diagnostics) {
+		decoder.withDiagnostics(&diagnostics->lastFrame);
+		diagnostics->lastFrame.sampleRate = backend->capturesEdges() ? 1000000 : sensorType->captureConfig.getSampleRate();
+	}
+	unlockRequests();
+}
+
+void DHT22Gen3::updateDecoder() {
+	if (backend->capturesEdges()) {
+		size_t count = backend->getEdgeCount();
+		if (count > decodedCount) {
+			decoder.addEdges(backend->getEdgeBuffer() + decodedCount, count - decodedCount);
+			decodedCount = count;
+		}
+	}
+	else {
+		size_t count = backend->getCapturedWords();
+		if (count > decodedCount) {
+			decoder.addWords(backend->getCaptureBuffer() + decodedCount, count - decodedCount);
+			decodedCount = count;
+		}
+	}
+}
+
+DHT22Gen3 &DHT22Gen3::withQueueDepth(size_t depth) {
+	if (depth > DHT22GEN3_MAX_QUEUE_DEPTH) {
+		depth = DHT22GEN3_MAX_QUEUE_DEPTH;
+	}
+	this->queueDepth = depth;
+	return *this;
+}
+
+void DHT22Gen3::getSample(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType) {
+	if (!workerThread) {
+		addRequest(dhtPin, completion, sensorType);
+		return;
+	}
+
+	lockRequests();
+	bool posted = postRequest(dhtPin, completion, sensorType, false);
+	unlockRequests();
+
+	if (!posted) {
 		DHTSample tempResult;
-		tempResult.withBusy();
+		if (queueDepth == 0) {
+			tempResult.withBusy();
+		}
+		else {
+			tempResult.withQueueFull();
+		}
 		if (completion) {
 			completion(tempResult);
 		}
+	}
+}
+
+DHTSample DHT22Gen3::readSample(pin_t dhtPin, DHTSensorType *sensorType, unsigned long timeoutMs) {
+	DHTSample sample;
+	sample.withSensorType(sensorType);
+
+	// Without the worker thread nothing would finish the sample while this thread waits, and
+	// on the worker thread (from a completion) it would wait for itself
+	if (!worker || os_thread_is_current(worker)) {
+		return sample.withError();
+	}
+
+	lockRequests();
+	Waiter *waiter = 0;
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_QUEUE_DEPTH + 1; ii++) {
+		if (!waiters[ii].inUse && waiters[ii].semaphore) {
+			waiter = &waiters[ii];
+			break;
+		}
+	}
+	bool posted = false;
+	if (waiter) {
+		posted = postRequest(dhtPin, [this, waiter](const DHTSample &finished) {
+			finishRead(waiter, finished);
+		}, sensorType, true);
+	}
+	if (posted) {
+		waiter->inUse = true;
+		waiter->done = false;
+		waiter->abandoned = false;
+	}
+	unlockRequests();
+
+	if (!posted) {
+		return (queueDepth == 0) ? sample.withBusy() : sample.withQueueFull();
+	}
+
+	bool signaled = (os_semaphore_take(waiter->semaphore, timeoutMs, false) == 0);
+
+	lockRequests();
+	if (signaled || waiter->done) {
+		if (!signaled) {
+			// Finished between the timeout and locking the mutex, so the semaphore was given
+			os_semaphore_take(waiter->semaphore, 0, false);
+		}
+		sample = waiter->sample;
+		waiter->inUse = false;
+	}
+	else {
+		// Still queued or in progress. finishRead() releases the waiter when it completes.
+		waiter->abandoned = true;
+		sample.withTimeout();
+	}
+	unlockRequests();
+
+	if (!sample.isTimeout()) {
+		updateAttachments(dhtPin, sample);
+	}
+	return sample;
+}
+
+void DHT22Gen3::finishRead(Waiter *waiter, const DHTSample &sample) {
+	lockRequests();
+	if (waiter->abandoned) {
+		waiter->inUse = false;
+	}
+	else {
+		waiter->sample = sample;
+		waiter->done = true;
+		os_semaphore_give(waiter->semaphore, false);
+	}
+	unlockRequests();
+}
+
+bool DHT22Gen3::postRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker) {
+	// activeCount limits the requests so the worker never has to reject one. pendingCount only
+	// counts getSample() requests, so completedQueue cannot fill up even if loop() is not called
+	// for a while, but readSample() does not depend on loop().
+	if (activeCount > queueDepth || (!onWorker && pendingCount > queueDepth)) {
+		return false;
+	}
+
+	Request req;
+	req.dhtPin = dhtPin;
+	req.completion = completion;
+	req.sensorType = sensorType;
+	req.onWorker = onWorker;
+	requestQueue.push(req);
+	activeCount++;
+	if (!onWorker) {
+		pendingCount++;
+	}
+	wakeWorker();
+	return true;
+}
+
+void DHT22Gen3::addRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker) {
+	if (state == State::IDLE_STATE && queueCount == 0) {
+		startRequest(dhtPin, completion, sensorType, onWorker);
 		return;
 	}
 
+	if (queueCount >= queueDepth) {
+		DHTSample tempResult;
+		if (queueDepth == 0) {
+			tempResult.withBusy();
+		}
+		else {
+			tempResult.withQueueFull();
+		}
+		rejectRequest(dhtPin, completion, tempResult, onWorker);
+		return;
+	}
+
+	Request &req = queue[(queueHead + queueCount) % DHT22GEN3_MAX_QUEUE_DEPTH];
+	req.dhtPin = dhtPin;
+	req.completion = completion;
+	req.sensorType = sensorType;
+	req.onWorker = onWorker;
+	queueCount++;
+}
+
+void DHT22Gen3::startRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker) {
 	this->dhtPin = dhtPin;
 	this->completion = completion;
 	this->sensorType = sensorType;
+	completionOnWorker = onWorker;
+	curSensor = findSensor(dhtPin, true);
 	result.tries = 0;
-	result.sensorType = sensorType;
+	result.withSensorType(sensorType);
 	state = State::START_STATE;
+}
+
+void DHT22Gen3::startNextRequest() {
+	if (state != State::IDLE_STATE || queueCount == 0) {
+		return;
+	}
+
+	// Prefer the oldest request for a sensor that isn't waiting for minSamplePeriodMs to elapse
+	size_t offset = 0;
+	for(size_t ii = 0; ii < queueCount; ii++) {
+		const Request &req = queue[(queueHead + ii) % DHT22GEN3_MAX_QUEUE_DEPTH];
+		if (isSensorReady(req.dhtPin, req.sensorType)) {
+			offset = ii;
+			break;
+		}
+	}
+
+	Request &req = queue[(queueHead + offset) % DHT22GEN3_MAX_QUEUE_DEPTH];
+	startRequest(req.dhtPin, req.completion, req.sensorType, req.onWorker);
+
+	// Close the gap in the queue by moving older requests up one slot
+	for(size_t ii = offset; ii > 0; ii--) {
+		Request &dst = queue[(queueHead + ii) % DHT22GEN3_MAX_QUEUE_DEPTH];
+		Request &src = queue[(queueHead + ii - 1) % DHT22GEN3_MAX_QUEUE_DEPTH];
+		dst.dhtPin = src.dhtPin;
+		dst.sensorType = src.sensorType;
+		dst.completion = src.completion;
+		dst.onWorker = src.onWorker;
+	}
+	queue[queueHead].completion = DHTCompletion();
+
+	queueHead = (queueHead + 1) % DHT22GEN3_MAX_QUEUE_DEPTH;
+	queueCount--;
+}
+
+bool DHT22Gen3::addPeriodicSample(pin_t dhtPin, unsigned long intervalMs, DHTCompletion completion, DHTSensorType *sensorType) {
+	Periodic *entry = 0;
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_PERIODIC; ii++) {
+		if (periodic[ii].inUse && periodic[ii].dhtPin == dhtPin) {
+			entry = &periodic[ii];
+			break;
+		}
+		if (!periodic[ii].inUse && !entry) {
+			entry = &periodic[ii];
+		}
+	}
+	if (!entry) {
+		return false;
+	}
+
+	if (intervalMs < sensorType->minSamplePeriodMs) {
+		intervalMs = sensorType->minSamplePeriodMs;
+	}
+
+	// Find the first slot PERIODIC_SPACING_MS apart from now that isn't within PERIODIC_SPACING_MS
+	// of the next sample of another sensor, so sensors added together don't all start at once
+	unsigned long now = backend->getMillis();
+	unsigned long nextTime = now;
+	for(size_t slot = 0; slot <= DHT22GEN3_MAX_PERIODIC; slot++) {
+		nextTime = now + slot * PERIODIC_SPACING_MS;
+
+		bool conflict = false;
+		for(size_t ii = 0; ii < DHT22GEN3_MAX_PERIODIC; ii++) {
+			const Periodic &other = periodic[ii];
+			if (&other == entry || !other.inUse) {
+				continue;
+			}
+			long delta = (long)(other.nextTime - nextTime);
+			if (delta > -(long)PERIODIC_SPACING_MS && delta < (long)PERIODIC_SPACING_MS) {
+				conflict = true;
+				break;
+			}
+		}
+		if (!conflict) {
+			break;
+		}
+	}
+
+	if (!entry->inUse) {
+		// A new entry. An existing entry keeps its generation and pending flag, so the sample in
+		// progress is still delivered and a second one isn't started until it completes.
+		entry->inUse = true;
+		entry->pending = false;
+		if (++periodicGeneration == 0) {
+			periodicGeneration = 1;
+		}
+		entry->generation = periodicGeneration;
+	}
+	entry->dhtPin = dhtPin;
+	entry->sensorType = sensorType;
+	entry->intervalMs = intervalMs;
+	entry->nextTime = nextTime;
+	entry->completion = completion;
+	return true;
+}
+
+bool DHT22Gen3::removePeriodicSample(pin_t dhtPin) {
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_PERIODIC; ii++) {
+		if (periodic[ii].inUse && periodic[ii].dhtPin == dhtPin) {
+			periodic[ii] = Periodic();
+			return true;
+		}
+	}
+	return false;
+}
 
+bool DHT22Gen3::setPeriodicDeadband(pin_t dhtPin, uint16_t tempDeciC, uint16_t humidityDeci, unsigned long maxSilenceMs) {
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_PERIODIC; ii++) {
+		Periodic &entry = periodic[ii];
+		if (entry.inUse && entry.dhtPin == dhtPin) {
+			entry.deadbandTempDeciC = tempDeciC;
+			entry.deadbandHumidityDeci = humidityDeci;
+			entry.maxSilenceMs = maxSilenceMs;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DHT22Gen3::checkPeriodic() {
+	unsigned long now = 0;
+	bool haveNow = false;
+
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_PERIODIC; ii++) {
+		Periodic &entry = periodic[ii];
+		if (!entry.inUse || entry.pending) {
+			continue;
+		}
+		if (!haveNow) {
+			// Only read the clock if there are periodic sensors
+			now = backend->getMillis();
+			haveNow = true;
+		}
+		if ((long)(now - entry.nextTime) < 0 || !canGetSample()) {
+			continue;
+		}
+
+		// Schedule from the previous due time so the interval does not drift. If the sample was
+		// delayed by more than an interval (retries, or the queue was full), start over from now.
+		entry.nextTime += entry.intervalMs;
+		if ((long)(now - entry.nextTime) >= 0) {
+			entry.nextTime = now + entry.intervalMs;
+		}
+
+		entry.pending = true;
+		uint32_t generation = entry.generation;
+		getSample(entry.dhtPin, [this, ii, generation](const DHTSample &sample) {
+			periodicCompletion(ii, generation, sample);
+		}, entry.sensorType);
+	}
+}
+
+void DHT22Gen3::periodicCompletion(size_t index, uint32_t generation, const DHTSample &sample) {
+	Periodic &entry = periodic[index];
+	if (!entry.inUse || entry.generation != generation || !entry.pending) {
+		// Removed while the sample was in progress, and possibly added again
+		return;
+	}
+	entry.pending = false;
+	if (!entry.checkDeadband(sample, backend->getMillis())) {
+		return;
+	}
+	if (entry.completion) {
+		entry.completion(sample);
+	}
+}
+
+bool DHT22Gen3::Periodic::checkDeadband(const DHTSample &sample, unsigned long now) {
+	if (!sample.isSuccess()) {
+		// Always report failures
+		return true;
+	}
+
+	int16_t tempDeciC = sample.getTempDeciC();
+	int16_t humidityDeci = sample.getHumidityDeci();
+
+	bool report = !hasReported || (deadbandTempDeciC == 0 && deadbandHumidityDeci == 0 && maxSilenceMs == 0);
+	if (!report && deadbandTempDeciC && abs(tempDeciC - reportedTempDeciC) >= deadbandTempDeciC) {
+		report = true;
+	}
+	if (!report && deadbandHumidityDeci && abs(humidityDeci - reportedHumidityDeci) >= deadbandHumidityDeci) {
+		report = true;
+	}
+	if (!report && maxSilenceMs && now - reportedTime >= maxSilenceMs) {
+		report = true;
+	}
+
+	if (report) {
+		hasReported = true;
+		reportedTempDeciC = tempDeciC;
+		reportedHumidityDeci = humidityDeci;
+		reportedTime = now;
+	}
+	return report;
+}
+
+bool DHT22Gen3::addHistory(pin_t dhtPin, DHTHistory *history) {
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, true);
+	if (entry) {
+		entry->history = history;
+	}
+	unlockRequests();
+	return entry != 0;
+}
+
+bool DHT22Gen3::removeHistory(pin_t dhtPin) {
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, false);
+	bool removed = entry && entry->history;
+	if (removed) {
+		entry->history = 0;
+	}
+	unlockRequests();
+	return removed;
+}
+
+DHTHistory *DHT22Gen3::getHistory(pin_t dhtPin) const {
+	DHTHistory *result = 0;
+	lockRequests();
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_SENSORS; ii++) {
+		if (attachments[ii].inUse() && attachments[ii].dhtPin == dhtPin) {
+			result = attachments[ii].history;
+			break;
+		}
+	}
+	unlockRequests();
+	return result;
+}
+
+bool DHT22Gen3::addStats(pin_t dhtPin, DHTSensorStats *stats) {
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, true);
+	if (entry) {
+		entry->stats = stats;
+	}
+	unlockRequests();
+	return entry != 0;
+}
+
+bool DHT22Gen3::removeStats(pin_t dhtPin) {
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, false);
+	bool removed = entry && entry->stats;
+	if (removed) {
+		entry->stats = 0;
+	}
+	unlockRequests();
+	return removed;
+}
+
+DHTSensorStats *DHT22Gen3::getStats(pin_t dhtPin) const {
+	DHTSensorStats *result = 0;
+	lockRequests();
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_SENSORS; ii++) {
+		if (attachments[ii].inUse() && attachments[ii].dhtPin == dhtPin) {
+			result = attachments[ii].stats;
+			break;
+		}
+	}
+	unlockRequests();
+	return result;
+}
+
+bool DHT22Gen3::addDiagnostics(pin_t dhtPin, DHTSensorDiagnostics *diagnostics) {
+	// With the worker thread, the worker holds the lock while it uses the diagnostics
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, true);
+	if (entry) {
+		if (entry->diagnostics && decoder.getDiagnostics() == &entry->diagnostics->lastFrame) {
+			// Replaced, so stop recording into the frame of the sample in progress
+			decoder.withDiagnostics(0);
+		}
+		entry->diagnostics = diagnostics;
+	}
+	unlockRequests();
+	return entry != 0;
+}
+
+bool DHT22Gen3::removeDiagnostics(pin_t dhtPin) {
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, false);
+	bool removed = entry && entry->diagnostics;
+	if (removed) {
+		if (decoder.getDiagnostics() == &entry->diagnostics->lastFrame) {
+			// Stop recording into the frame of the sample in progress
+			decoder.withDiagnostics(0);
+		}
+		entry->diagnostics = 0;
+	}
+	unlockRequests();
+	return removed;
+}
+
+DHTSensorDiagnostics *DHT22Gen3::getDiagnostics(pin_t dhtPin) const {
+	DHTSensorDiagnostics *result = 0;
+	lockRequests();
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_SENSORS; ii++) {
+		if (attachments[ii].inUse() && attachments[ii].dhtPin == dhtPin) {
+			result = attachments[ii].diagnostics;
+			break;
+		}
+	}
+	unlockRequests();
+	return result;
+}
+
+DHT22Gen3::Attachment *DHT22Gen3::findAttachment(pin_t dhtPin, bool create) {
+	Attachment *unused = 0;
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_SENSORS; ii++) {
+		Attachment *entry = &attachments[ii];
+		if (!entry->inUse()) {
+			if (!unused) {
+				unused = entry;
+			}
+			continue;
+		}
+		if (entry->dhtPin == dhtPin) {
+			return entry;
+		}
+	}
+	if (!create || !unused) {
+		return 0;
+	}
+
+	*unused = Attachment();
+	unused->dhtPin = dhtPin;
+	return unused;
+}
+
+void DHT22Gen3::updateAttachments(pin_t dhtPin, const DHTSample &sample) {
+	// With the worker thread, this is called from loop() and from threads in readSample()
+	lockRequests();
+	Attachment *entry = findAttachment(dhtPin, false);
+	if (entry) {
+		if (entry->history) {
+			entry->history->add(backend->getMillis(), sample);
+		}
+		if (entry->stats && sample.isSuccess()) {
+			entry->stats->add(sample.getTempDeciC(), sample.getHumidityDeci());
+		}
+	}
+	unlockRequests();
+}
+
+DHT22Gen3::SensorInfo *DHT22Gen3::findSensor(pin_t dhtPin, bool create) {
+	SensorInfo *unused = 0;
+	SensorInfo *oldest = 0;
+	unsigned long now = backend->getMillis();
+
+	for(size_t ii = 0; ii < DHT22GEN3_MAX_SENSORS; ii++) {
+		SensorInfo *info = &sensors[ii];
+		if (!info->inUse) {
+			if (!unused) {
+				unused = info;
+			}
+			continue;
+		}
+		if (info->dhtPin == dhtPin) {
+			return info;
+		}
+		if ((!oldest || (now - info->lastRequestTime) > (now - oldest->lastRequestTime))) {
+			oldest = info;
+		}
+	}
+	if (!create) {
+		return 0;
+	}
+
+	SensorInfo *info = unused ? unused : oldest;
+	*info = SensorInfo();
+	info->inUse = true;
+	info->dhtPin = dhtPin;
+	return info;
+}
+
+bool DHT22Gen3::isSensorReady(pin_t dhtPin, const DHTSensorType *sensorType) {
+	const SensorInfo *info = findSensor(dhtPin, false);
+	return !info || info->lastRequestTime == 0 || backend->getMillis() - info->lastRequestTime >= sensorType->minSamplePeriodMs;
 }
 
 void DHT22Gen3::callCompletion(DHTSample::SampleResult sampleResult) {
 	result.sampleResult = sampleResult;
 	state = State::IDLE_STATE;
-	if (completion) {
-		completion(result);
+
+	// Copy the completion out of the member variable first, because the completion handler
+	// may call getSample(), which replaces it
+	DHTCompletion tempCompletion = completion;
+	completion = DHTCompletion();
+
+	if (workerThread && completionOnWorker) {
+		// From readSample(), which wakes the waiting thread
+		activeCount--;
+		if (tempCompletion) {
+			tempCompletion(result);
+		}
+	}
+	else if (workerThread) {
+		// loop() updates the attachments and calls the completion on the application thread.
+		// getSample() limits the requests in progress so this cannot be full.
+		Completed entry;
+		entry.dhtPin = dhtPin;
+		entry.sample = result;
+		entry.completion = tempCompletion;
+		completedQueue.push(entry);
+		activeCount--;
+	}
+	else {
+		updateAttachments(dhtPin, result);
+		if (tempCompletion) {
+			tempCompletion(result);
+		}
+	}
+
+	// If the completion handler did not start a new sample, start the next queued request
+	startNextRequest();
+}
+
+void DHT22Gen3::rejectRequest(pin_t dhtPin, DHTCompletion completion, const DHTSample &sample, bool onWorker) {
+	if (workerThread && onWorker) {
+		activeCount--;
+		if (completion) {
+			completion(sample);
+		}
+	}
+	else if (workerThread) {
+		Completed entry;
+		entry.dhtPin = dhtPin;
+		entry.sample = sample;
+		entry.completion = completion;
+		completedQueue.push(entry);
+		activeCount--;
+	}
+	else if (completion) {
+		completion(sample);
+	}
+}
+
+void DHT22Gen3::lockRequests() const {
+	if (requestMutex) {
+		os_mutex_lock(requestMutex);
+	}
+}
+
+void DHT22Gen3::unlockRequests() const {
+	if (requestMutex) {
+		os_mutex_unlock(requestMutex);
+	}
+}
+
+void DHT22Gen3::wakeWorker() {
+	if (worker) {
+		os_semaphore_give(workerSemaphore, false);
 	}
 }
 
+// [static]
+os_thread_return_t DHT22Gen3::workerThreadFunction(void *param) {
+	DHT22Gen3 *dht = (DHT22Gen3 *)param;
 
+	while(true) {
+		dht->process();
 
+		// Sleep until getSample() or the capture interrupt wakes the thread, or process() has
+		// something to do
+		os_semaphore_take(dht->workerSemaphore, dht->getWorkerTimeout(), false);
+	}
+}
 
+system_tick_t DHT22Gen3::getWorkerTimeout() {
+	switch(state) {
+	case State::IDLE_STATE:
+		return CONCURRENT_WAIT_FOREVER;
 
+	case State::START_STATE: {
+		// Waiting for the minimum sample period of the sensor, which can be up to 2 seconds
+		unsigned long elapsed = backend->getMillis() - curSensor->lastRequestTime;
+		if (curSensor->lastRequestTime != 0 && elapsed < sensorType->minSamplePeriodMs) {
+			return (system_tick_t)(sensorType->minSamplePeriodMs - elapsed);
+		}
+		return 1;
+	}
+
+	default:
+		// Start pulse and capture timeouts
+		return 1;
+	}
+}
+
+// [static]
+void DHT22Gen3::workerCaptureHandler(void *context) {
+	// os_semaphore_give() can be called from an interrupt handler
+	((DHT22Gen3 *)context)->wakeWorker();
+}
@@ -3,9 +3,65 @@
 
 #include "Particle.h"
 
+#include <new>
+#include <type_traits>
+
+#include "DHTBackend.h"
+#include "DHTDecoder.h"
+#include "DHTQueue.h"
+#include "DHTStats.h"
+
 // Repository: https://github.com/rickkas7/DHT22Gen3_RK
 // License: MIT
 
+/**
+ * @brief Maximum number of getSample() requests that can be waiting while another is in progress
+ *
+ * The queue is statically allocated inside the DHT22Gen3 object. You can reduce the number actually
+ * used at runtime with DHT22Gen3::withQueueDepth().
+ *
+ * This and the other DHT22GEN3_MAX values below are fixed library constants. They size arrays
+ * inside DHT22Gen3, so the library and every file that includes this header must agree on them;
+ * don't define them before including DHT22Gen3_RK.h.
+ */
+#define DHT22GEN3_MAX_QUEUE_DEPTH 8
+
+/**
+ * @brief Maximum number of sensors (pins) that per-sensor information is kept for
+ *
+ * This is used to enforce the minimum sample period separately for each sensor. If you have more
+ * sensors than this, the least recently used entry is reused.
+ */
+#define DHT22GEN3_MAX_SENSORS 8
+
+/**
+ * @brief Maximum number of sensors that can be sampled periodically using addPeriodicSample()
+ */
+#define DHT22GEN3_MAX_PERIODIC 8
+
+/**
+ * @brief Number of bytes of captured variables a completion lambda can have
+ *
+ * This is enough for 4 pointers (16 bytes on the device). Capture a pointer to a struct if you
+ * need more.
+ */
+#define DHT22GEN3_COMPLETION_SIZE (4 * sizeof(void *))
+
+/**
+ * @brief Stack size in bytes of the worker thread created by DHT22Gen3::withWorkerThread()
+ *
+ * Completions are not called on the worker thread, so it only needs enough stack to decode and log.
+ */
+#define DHT22GEN3_WORKER_STACK_SIZE 2048
+
+/**
+ * @brief Priority of the worker thread created by DHT22Gen3::withWorkerThread()
+ *
+ * This is higher than the application thread, so the worker runs as soon as the capture
+ * interrupt wakes it, even if loop() is busy.
+ */
+#define DHT22GEN3_WORKER_PRIORITY (OS_THREAD_PRIORITY_DEFAULT + 1)
+
 class DHTSample; // Forward declaration
 
 /**
@@ -20,15 +76,64 @@ public:
 	 *
 	 * @param minSamplePeriodMs Minimum number of milliseconds between queries to the sensor
 	 *
-	 * @param oneBitThreshold Number of counts for the bit in the I2S buffer to be considered a 1 bit
+	 * @param oneBitThreshold Number of counts for the bit in the I2S buffer to be considered a 1 bit,
+	 * at the 512 kHz sample rate of DHTCaptureConfig::CONFIG_512K
+	 *
+	 * Versions 0.0.4 and earlier sampled at 512 kHz, so existing custom sensor types have a
+	 * threshold for that rate. This constructor uses DHTCaptureConfig::CONFIG_128K, which fits in
+	 * the default capture buffer, and scales the threshold to 128 kHz (25 becomes 6).
 	 */
 	DHTSensorType(const char *name, unsigned long minSamplePeriodMs, unsigned long oneBitThreshold) :
-			name(name), minSamplePeriodMs(minSamplePeriodMs), oneBitThreshold(oneBitThreshold) {};
+			name(name), minSamplePeriodMs(minSamplePeriodMs), oneBitThreshold(scaleThreshold(oneBitThreshold, DHTCaptureConfig::CONFIG_512K, DHTCaptureConfig::CONFIG_128K)), captureConfig(DHTCaptureConfig::CONFIG_128K), typeTag(registerType(this)) {};
+
+	/**
+	 * @brief Constructor for a sensor type with a specific sample rate
+	 *
+	 * @param name Short descriptive name (DHT11, DHT22)
+	 *
+	 * @param minSamplePeriodMs Minimum number of milliseconds between queries to the sensor
+	 *
+	 * @param oneBitThreshold Number of counts for the bit in the I2S buffer to be considered a 1 bit,
+	 * at the sample rate in captureConfig. A high period of about 48 us is a good threshold.
+	 *
+	 * @param captureConfig Sample rate and number of words to capture
+	 */
+	DHTSensorType(const char *name, unsigned long minSamplePeriodMs, unsigned long oneBitThreshold, const DHTCaptureConfig &captureConfig) :
+			name(name), minSamplePeriodMs(minSamplePeriodMs), oneBitThreshold(oneBitThreshold), captureConfig(captureConfig), typeTag(registerType(this)) {};
 
 	/**
 	 * @brief Destructor
 	 */
-	virtual ~DHTSensorType() {};
+	virtual ~DHTSensorType();
+
+	/**
+	 * @brief Type tag stored in DHTSample for samples without a sensor type
+	 */
+	static const uint8_t TYPE_TAG_NONE = 0;
+
+	/**
+	 * @brief Type tag of DHT22Gen3::sensorTypeDHT11
+	 */
+	static const uint8_t TYPE_TAG_DHT11 = 1;
+
+	/**
+	 * @brief Type tag of DHT22Gen3::sensorTypeDHT22
+	 */
+	static const uint8_t TYPE_TAG_DHT22 = 2;
+
+	/**
+	 * @brief Number of type tags. Tags 3 to 7 are assigned to custom sensor types as they are constructed.
+	 */
+	static const size_t NUM_TYPE_TAGS = 8;
+
+	/**
+	 * @brief Returns the sensor type for a type tag
+	 *
+	 * @param typeTag The tag, from DHTSample or typeTag
+	 *
+	 * @return The sensor type, or 0 if no sensor type has that tag
+	 */
+	static DHTSensorType *fromTypeTag(uint8_t typeTag) { return (typeTag < NUM_TYPE_TAGS) ? sensorTypes[typeTag] : 0; };
 
 	/**
 	 * @brief For the sample, convert it into degrees C based on the sensor type
@@ -44,10 +149,152 @@ public:
 	 */
 	virtual float getHumidity(const DHTSample &sample) const = 0;
 
+	/**
+	 * @brief For the sample, convert it into tenths of a degree C based on the sensor type
+	 *
+	 * @param sample The sample data to convert
+	 *
+	 * The default implementation rounds getTempC(). The built-in types override this to use integer
+	 * math only.
+	 */
+	virtual int16_t getTempDeciC(const DHTSample &sample) const;
+
+	/**
+	 * @brief For the sample, convert it into tenths of a percent humidity (0-1000) based on the sensor type
+	 *
+	 * @param sample The sample data to convert
+	 *
+	 * The default implementation rounds getHumidity(). The built-in types override this to use integer
+	 * math only.
+	 */
+	virtual int16_t getHumidityDeci(const DHTSample &sample) const;
+
 
 	const char *name;					//!< Short name of sensor
 	unsigned long minSamplePeriodMs; 	//!< Minimum period between samples.
 	int oneBitThreshold;				//!< Threshold in number of I2S bits for a 1-bit
+	DHTCaptureConfig captureConfig;		//!< I2S sample rate and number of words to capture
+	int oneBitThresholdUs = 48;			//!< Threshold in microseconds for a 1-bit, used with edge capture backends
+	uint32_t startPulseUs = 18000;		//!< Length of the low start pulse in microseconds. The default of 18 ms works with all sensors.
+
+	/**
+	 * @brief Small number that identifies this sensor type in a DHTSample
+	 *
+	 * TYPE_TAG_DHT11 and TYPE_TAG_DHT22 for the built-in types. Custom types are assigned 3 to 7
+	 * in the order they are constructed. If more than 5 custom types exist, the additional ones
+	 * are TYPE_TAG_NONE and their samples can't be converted.
+	 */
+	const uint8_t typeTag;
+
+protected:
+	/**
+	 * @brief Constructor used by the built-in sensor types, which have a fixed type tag
+	 */
+	DHTSensorType(uint8_t typeTag, const char *name, unsigned long minSamplePeriodMs, unsigned long oneBitThreshold, const DHTCaptureConfig &captureConfig);
+
+	/**
+	 * @brief Used internally to assign the next free type tag to a custom sensor type
+	 */
+	static uint8_t registerType(DHTSensorType *sensorType);
+
+	/**
+	 * @brief Used internally to convert a threshold in samples from one sample rate to another, rounded
+	 */
+	static unsigned long scaleThreshold(unsigned long threshold, const DHTCaptureConfig &from, const DHTCaptureConfig &to);
+
+	static DHTSensorType *sensorTypes[NUM_TYPE_TAGS]; //!< Sensor type for each type tag, used by fromTypeTag()
+};
+
+/**
+ * @brief Compile-time description of the DHT11
+ *
+ * The sensor traits classes hold the constants and data conversions of a sensor type as static
+ * constexpr members, so code that knows the sensor type at compile time can convert the raw bytes
+ * without a virtual call, and the compiler can fold the sign and scale math. They are used by the
+ * template versions of DHTSample::getTempC<>() and getHumidity<>(), DHT22Gen3::getSample<>(), and
+ * by the DHTSensorTypeDHT11 runtime object, so the values are only defined in one place.
+ */
+class DHTTraitsDHT11 {
+public:
+	static constexpr uint8_t typeTag = DHTSensorType::TYPE_TAG_DHT11; //!< DHTSensorType::typeTag
+	static constexpr unsigned long minSamplePeriodMs = 1000; //!< Minimum period between samples
+	static constexpr int oneBitThreshold = 6; //!< Threshold in samples at 128 kHz (DHTCaptureConfig::CONFIG_128K)
+	static constexpr int oneBitThresholdUs = 48; //!< Threshold in microseconds for edge capture
+	static constexpr uint32_t startPulseUs = 18000; //!< Start pulse length, the datasheet requires at least 18 ms
+
+	/**
+	 * @brief Returns the short name of the sensor
+	 */
+	static constexpr const char *getName() { return "DHT11"; };
+
+	/**
+	 * @brief Temperature in tenths of a degree C. The DHT11 only reports whole degrees.
+	 */
+	static constexpr int16_t getTempDeciC(const uint8_t *bytes) { return (int16_t)((int8_t)bytes[2] * 10); };
+
+	/**
+	 * @brief Relative humidity in tenths of a percent. The DHT11 only reports whole percents.
+	 */
+	static constexpr int16_t getHumidityDeci(const uint8_t *bytes) { return (int16_t)((int8_t)bytes[0] * 10); };
+
+	/**
+	 * @brief Temperature in degrees C
+	 */
+	static constexpr float getTempC(const uint8_t *bytes) { return (float)(int8_t)bytes[2]; };
+
+	/**
+	 * @brief Relative humidity in percent (0 - 100)
+	 */
+	static constexpr float getHumidity(const uint8_t *bytes) { return (float)(int8_t)bytes[0]; };
+
+	/**
+	 * @brief Returns the runtime sensor type object, DHT22Gen3::sensorTypeDHT11
+	 */
+	static DHTSensorType *getSensorType();
+};
+
+/**
+ * @brief Compile-time description of the DHT22 (AM2302). See DHTTraitsDHT11.
+ */
+class DHTTraitsDHT22 {
+public:
+	static constexpr uint8_t typeTag = DHTSensorType::TYPE_TAG_DHT22; //!< DHTSensorType::typeTag
+	static constexpr unsigned long minSamplePeriodMs = 2000; //!< Minimum period between samples
+	static constexpr int oneBitThreshold = 6; //!< Threshold in samples at 128 kHz (DHTCaptureConfig::CONFIG_128K)
+	static constexpr int oneBitThresholdUs = 48; //!< Threshold in microseconds for edge capture
+	static constexpr uint32_t startPulseUs = 1100; //!< Start pulse length, the datasheet requires at least 1 ms
+
+	/**
+	 * @brief Returns the short name of the sensor
+	 */
+	static constexpr const char *getName() { return "DHT22"; };
+
+	/**
+	 * @brief Temperature in tenths of a degree C. Sign and magnitude, not two's complement.
+	 */
+	static constexpr int16_t getTempDeciC(const uint8_t *bytes) {
+		return (bytes[2] & 0x80) ? (int16_t)-(((bytes[2] & 0x7f) << 8) | bytes[3]) : (int16_t)((bytes[2] << 8) | bytes[3]);
+	};
+
+	/**
+	 * @brief Relative humidity in tenths of a percent
+	 */
+	static constexpr int16_t getHumidityDeci(const uint8_t *bytes) { return (int16_t)((bytes[0] << 8) | bytes[1]); };
+
+	/**
+	 * @brief Temperature in degrees C
+	 */
+	static constexpr float getTempC(const uint8_t *bytes) { return getTempDeciC(bytes) * 0.1f; };
+
+	/**
+	 * @brief Relative humidity in percent (0 - 100)
+	 */
+	static constexpr float getHumidity(const uint8_t *bytes) { return getHumidityDeci(bytes) * 0.1f; };
+
+	/**
+	 * @brief Returns the runtime sensor type object, DHT22Gen3::sensorTypeDHT22
+	 */
+	static DHTSensorType *getSensorType();
 };
 
 /**
@@ -76,6 +323,20 @@ public:
 	 * @param sample The sample data to convert
 	 */
 	virtual float getHumidity(const DHTSample &sample) const;
+
+	/**
+	 * @brief For the sample, convert it into tenths of a degree C
+	 *
+	 * @param sample The sample data to convert
+	 */
+	virtual int16_t getTempDeciC(const DHTSample &sample) const;
+
+	/**
+	 * @brief For the sample, convert it into tenths of a percent humidity (0-1000)
+	 *
+	 * @param sample The sample data to convert
+	 */
+	virtual int16_t getHumidityDeci(const DHTSample &sample) const;
 };
 
 
@@ -105,11 +366,29 @@ public:
 	 * @param sample The sample data to convert
 	 */
 	virtual float getHumidity(const DHTSample &sample) const;
+
+	/**
+	 * @brief For the sample, convert it into tenths of a degree C
+	 *
+	 * @param sample The sample data to convert
+	 */
+	virtual int16_t getTempDeciC(const DHTSample &sample) const;
+
+	/**
+	 * @brief For the sample, convert it into tenths of a percent humidity (0-1000)
+	 *
+	 * @param sample The sample data to convert
+	 */
+	virtual int16_t getHumidityDeci(const DHTSample &sample) const;
 };
 
 
 /**
  * @brief Class for encapsulating the results to a call to getSample()
+ *
+ * This is a compact (8 byte), trivially copyable value, so it's cheap to copy, and arrays of
+ * samples can be stored in ring buffers, copied with memcpy, or saved to flash. The sensor type
+ * is stored as a small type tag (DHTSensorType::typeTag) instead of a pointer.
  */
 class DHTSample {
 public:
@@ -118,22 +397,26 @@ public:
 	 *
 	 * Success is 0. All other codes are errors
 	 */
-	enum class SampleResult {
+	enum class SampleResult : uint8_t {
 		SUCCESS = 0,		//!< Success (including valid checksum)
 		ERROR,				//!< An internal error (problem with the I2S peripheral, etc.)
 		TOO_MANY_RETRIES,	//!< After the specified number of retries, could not get a valid result
-		BUSY				//!< Called getSample() before the previous call completed
+		BUSY,				//!< Called getSample() before the previous call completed and queuing is disabled
+		QUEUE_FULL,			//!< Called getSample() while the request queue was full
+		TIMEOUT				//!< readSample() did not complete within the timeout
 	};
 
+	/**
+	 * @brief Maximum value returned by getTries(). The number of tries saturates at this value.
+	 */
+	static const int MAX_TRIES = 15;
+
 	/**
 	 * @brief Constructor
 	 *
 	 * You normally don't need to construct one of these; it's filled in for you by getSample()
 	 */
-	DHTSample();
-
-
-	virtual ~DHTSample(); //!< Destructor
+	DHTSample() : tries(0), typeTag(DHTSensorType::TYPE_TAG_NONE), repaired(0) {};
 
 	/**
 	 * @brief Clears the results
@@ -183,6 +466,57 @@ public:
 	 */
 	float getDewPointF() const;
 
+	/**
+	 * @brief Gets the temperature in tenths of a degree Celsius (215 = 21.5 C)
+	 *
+	 * For the built-in sensor types this only uses integer math. Returns 0 if the sample has no
+	 * sensor type. The value is undefined is isSuccess() is not true.
+	 */
+	int16_t getTempDeciC() const;
+
+	/**
+	 * @brief Gets the temperature in tenths of a degree Fahrenheit (707 = 70.7 F)
+	 */
+	int16_t getTempDeciF() const { return deciCToDeciF(getTempDeciC()); };
+
+	/**
+	 * @brief Gets the humidity in tenths of a percent RH (0-1000)
+	 *
+	 * For the built-in sensor types this only uses integer math. Returns 0 if the sample has no
+	 * sensor type. The value is undefined is isSuccess() is not true.
+	 */
+	int16_t getHumidityDeci() const;
+
+	/**
+	 * @brief Gets the dew point in tenths of a degree Celsius, calculated in fixed point
+	 *
+	 * See calculateDewPointDeciC(). The value is undefined is isSuccess() is not true.
+	 */
+	int16_t getDewPointDeciC() const { return calculateDewPointDeciC(getTempDeciC(), getHumidityDeci()); };
+
+	/**
+	 * @brief Gets the dew point in tenths of a degree Fahrenheit, calculated in fixed point
+	 */
+	int16_t getDewPointDeciF() const { return deciCToDeciF(getDewPointDeciC()); };
+
+	/**
+	 * @brief Calculates the dew point in tenths of a degree Celsius using only integer math
+	 *
+	 * @param tempDeciC Temperature in tenths of a degree C. Limited to -400 to 800 (-40 to 80 C).
+	 *
+	 * @param humidityDeci Relative humidity in tenths of a percent. Limited to 1 to 1000.
+	 *
+	 * This uses the same Magnus formula as getDewPointC(), with the logarithm calculated from a
+	 * 16-entry log2 table with linear interpolation. Over the whole range the result is within
+	 * 0.08 C of the floating point formula, including rounding to tenths (mean error 0.03 C).
+	 */
+	static int16_t calculateDewPointDeciC(int tempDeciC, int humidityDeci);
+
+	/**
+	 * @brief Converts tenths of a degree C to tenths of a degree F, rounded to nearest
+	 */
+	static constexpr int16_t deciCToDeciF(int tempDeciC) { return (int16_t)((tempDeciC * 18 + (tempDeciC >= 0 ? 5 : -5)) / 10 + 320); };
+
 	/**
 	 * @brief Gets the sample result value (0 = success, non-zero = error)
 	 *
@@ -198,6 +532,56 @@ public:
 	 */
 	int getTries() const { return tries; };
 
+	/**
+	 * @brief Returns true if one bit was flipped to make the checksum valid
+	 *
+	 * Only possible if DHT22Gen3::withChecksumRepair() is used. See getRepairMargin().
+	 */
+	bool isRepaired() const { return repaired; };
+
+	/**
+	 * @brief Returns the margin of the bit that was flipped by checksum repair, 0 if not repaired
+	 *
+	 * The margin is in samples (microseconds for edge capture backends), see DHTDecoder::getMargin().
+	 * It's stored in one byte, so margins larger than 255 are returned as 255.
+	 */
+	int getRepairMargin() const { return repairMargin; };
+
+	/**
+	 * @brief Gets the sensor type, which determines the data format of bytes
+	 *
+	 * @return The sensor type, or 0 if not set
+	 */
+	DHTSensorType *getSensorType() const { return DHTSensorType::fromTypeTag(typeTag); };
+
+	/**
+	 * @brief Gets the type tag of the sensor type (DHTSensorType::typeTag)
+	 */
+	uint8_t getTypeTag() const { return typeTag; };
+
+	/**
+	 * @brief Gets the temperature in degrees Celsius for a sensor type known at compile time
+	 *
+	 * For example, `sample.getTempC<DHTTraitsDHT22>()`. The conversion is inlined and does not
+	 * check the type tag of the sample.
+	 */
+	template<class Traits>
+	float getTempC() const { return Traits::getTempC(bytes); };
+
+	/**
+	 * @brief Gets the humidity in percent RH (0-100) for a sensor type known at compile time
+	 *
+	 * For example, `sample.getHumidity<DHTTraitsDHT22>()`. The conversion is inlined and does not
+	 * check the type tag of the sample.
+	 */
+	template<class Traits>
+	float getHumidity() const { return Traits::getHumidity(bytes); };
+
+	/**
+	 * @brief Gets the raw data bytes (5 bytes, the last is the checksum)
+	 */
+	const uint8_t *getBytes() const { return bytes; };
+
 	/**
 	 * @brief Sets the sample result to SUCCESS
 	 */
@@ -242,10 +626,30 @@ public:
 	 */
 	bool isTooManyRetries() const { return sampleResult == SampleResult::TOO_MANY_RETRIES; };
 
+	/**
+	 * @brief Sets the sample result to QUEUE_FULL
+	 */
+	DHTSample &withQueueFull() { sampleResult = SampleResult::QUEUE_FULL; return *this; };
+
+	/**
+	 * @brief Returns true if getSample() failed because the request queue was full
+	 */
+	bool isQueueFull() const { return sampleResult == SampleResult::QUEUE_FULL; };
+
+	/**
+	 * @brief Sets the sample result to TIMEOUT
+	 */
+	DHTSample &withTimeout() { sampleResult = SampleResult::TIMEOUT; return *this; };
+
+	/**
+	 * @brief Returns true if readSample() gave up waiting before the sample completed
+	 */
+	bool isTimeout() const { return sampleResult == SampleResult::TIMEOUT; };
+
 	/**
 	 * @brief Sets the data format of bytes
 	 */
-	DHTSample &withSensorType(DHTSensorType *sensorType) { this->sensorType = sensorType; return *this; };
+	DHTSample &withSensorType(const DHTSensorType *sensorType) { this->typeTag = sensorType ? sensorType->typeTag : DHTSensorType::TYPE_TAG_NONE; return *this; };
 
 	/**
 	 * @brief Get a byte from the bytes array
@@ -253,86 +657,598 @@ public:
 	uint8_t operator[](size_t index) const { return bytes[index]; };
 
 protected:
-	SampleResult sampleResult = SampleResult::ERROR;	//!< Result code. 0 is success, error are non-zero
-	DHTSensorType *sensorType = 0; //!< Sensor type for this sample
+	/**
+	 * @brief Used internally to count a try, saturating at MAX_TRIES
+	 */
+	void addTry() { if (tries < MAX_TRIES) { tries++; } };
+
 	uint8_t bytes[5] = {0};	//!< Raw bytes of data from DHT22
-	int tries = 0;	//!< Number of retries. Normally 1 for the initial try, will be greater for retries.
+	SampleResult sampleResult = SampleResult::ERROR;	//!< Result code. 0 is success, error are non-zero
+	uint8_t tries : 4;		//!< Number of tries. Normally 1 for the initial try, will be greater for retries.
+	uint8_t typeTag : 3;	//!< Sensor type for this sample, see DHTSensorType::fromTypeTag()
+	uint8_t repaired : 1;	//!< One bit was flipped to make the checksum valid, see isRepaired()
+	uint8_t repairMargin = 0; //!< Margin of the bit that was flipped, see getRepairMargin()
 	friend class DHT22Gen3;
 };
 
+static_assert(sizeof(DHTSample) <= 8, "DHTSample must fit in 8 bytes");
+static_assert(std::is_trivially_copyable<DHTSample>::value, "DHTSample must be trivially copyable");
+static_assert(std::is_standard_layout<DHTSample>::value, "DHTSample must be standard layout");
 
 /**
- * @brief Class for interfacing with one or more DHT22 sensors on a Gen3 Particle device
+ * @brief Completion handler for getSample() and addPeriodicSample() that never allocates memory
  *
- * Only allocate one of these, typically as a global variable, per device.
+ * This is constructed automatically from what you pass to getSample(), which can be:
  *
- * Be sure to call the setup() and loop() methods from the actual setup and loop.
+ * - A plain function, `void sampleCallback(const DHTSample &sample)`
+ * - A C++ lambda, `[](const DHTSample &sample) { ... }`
+ * - A function and a context pointer, `DHTCompletion(sampleCallback, this)` with
+ * `void sampleCallback(const DHTSample &sample, void *context)`
+ *
+ * Functions and lambdas that take a DHTSample by value also work. The lambda is stored inside
+ * this object instead of on the heap, so its captured variables must fit in
+ * DHT22GEN3_COMPLETION_SIZE bytes (4 pointers) and be trivially copyable, such as
+ * pointers, references, and numbers. Capture a pointer to a larger object instead of the object.
+ * This is checked at compile time.
+ *
+ * Unlike a std::function, this is trivially copyable, so queue entries holding one can be copied
+ * without allocating or freeing memory.
  */
-class DHT22Gen3 {
+class DHTCompletion {
 public:
 	/**
-	 * @brief Enumeration for possible states for the Finite State Machine
+	 * @brief Function type for the function and context pointer form
 	 */
-	enum class State {
-		IDLE_STATE,			//!< Idle, can call getSample()
-		START_STATE,		//!< Getting ready to get a sample
-		SEND_START_STATE,	//!< Sending the start bit and starting the I2S peripheral
-		SAMPLING_STATE		//!< Capturing samples
-	};
+	typedef void (*ContextFunction)(const DHTSample &sample, void *context);
 
 	/**
-	 * @brief Initialize the DHT22Gen3 driver
-	 *
-	 * @param unusedPin1 An unused GPIO pin to use for SCK. It's unfortunate, but for the I2S
-	 * peripheral to work, SCK must be mapped to a valid pin. It will be set to output and
-	 * there will be 512 KHz signal output on this pin.
-	 *
-	 * @param unusedPin2 An unused GPIO pin to use for LRCK. It's unfortunate, but for the I2S
-	 * peripheral to work, LRCK must be mapped to a valid pin. It will be set to output and
-	 * there will be 32 KHz signal output on this pin. It must be a different pin than unusedPin1.
-	 *
-	 * - You will often allocate this object as a global variable.
-	 * - There can only be one per device.
-	 * - Make sure you call setup() and loop() methods from your actual setup() and loop()!
+	 * @brief Default constructor. No function is called.
 	 */
-	DHT22Gen3(pin_t unusedPin1, pin_t unusedPin2);
-	virtual ~DHT22Gen3();
+	DHTCompletion() {};
 
 	/**
-	 * @brief Call from setup() to initialize the driver
+	 * @brief Construct with no function, same as the default constructor
 	 */
-	void setup();
+	DHTCompletion(std::nullptr_t) {};
 
 	/**
-	 * @brief Call from loop(), preferably every call to loop.
-	 *
-	 * This allows the completion function to be dispatched from normal loop execution time,
+	 * @brief Construct from a function and a context pointer, which is passed to the function
+	 */
+	DHTCompletion(ContextFunction fn, void *context) : invoker(invokeContext) {
+		ContextStorage *contextStorage = reinterpret_cast<ContextStorage *>(storage);
+		contextStorage->fn = fn;
+		contextStorage->context = context;
+	};
+
+	/**
+	 * @brief Construct from a function or lambda that takes a const DHTSample & (or a DHTSample)
+	 */
+	template<class F, typename std::enable_if<!std::is_same<typename std::decay<F>::type, DHTCompletion>::value && !std::is_same<typename std::decay<F>::type, std::nullptr_t>::value, int>::type = 0>
+	DHTCompletion(F fn) : invoker(invokeCallable<F>) {
+		static_assert(sizeof(F) <= DHT22GEN3_COMPLETION_SIZE, "completion captures too many variables, capture a pointer instead");
+		static_assert(alignof(F) <= alignof(void *), "completion captured variables are over-aligned");
+		static_assert(std::is_trivially_copyable<F>::value, "completion must only capture pointers, references, and numbers");
+		new(storage) F(fn);
+	};
+
+	/**
+	 * @brief Returns true if there is a function to call
+	 */
+	explicit operator bool() const { return invoker != 0; };
+
+	/**
+	 * @brief Calls the function, if there is one
+	 */
+	void operator()(const DHTSample &sample) {
+		if (invoker) {
+			invoker(storage, sample);
+		}
+	};
+
+protected:
+	/**
+	 * @brief Storage layout for the function and context pointer form
+	 */
+	struct ContextStorage {
+		ContextFunction fn; //!< Function to call
+		void *context; //!< Passed to fn
+	};
+
+	/**
+	 * @brief Used internally to call a function and context pointer
+	 */
+	static void invokeContext(void *storage, const DHTSample &sample) {
+		ContextStorage *contextStorage = reinterpret_cast<ContextStorage *>(storage);
+		contextStorage->fn(sample, contextStorage->context);
+	};
+
+	/**
+	 * @brief Used internally to call a function or lambda stored in storage
+	 */
+	template<class F>
+	static void invokeCallable(void *storage, const DHTSample &sample) {
+		(*reinterpret_cast<F *>(storage))(sample);
+	};
+
+	void (*invoker)(void *storage, const DHTSample &sample) = 0; //!< Calls the stored function, or 0 if none
+	alignas(void *) uint8_t storage[DHT22GEN3_COMPLETION_SIZE > sizeof(ContextStorage) ? DHT22GEN3_COMPLETION_SIZE : sizeof(ContextStorage)]; //!< Stored function, lambda, or ContextStorage
+};
+
+
+/**
+ * @brief A sample and the time it was taken, stored in a DHTHistory
+ *
+ * This is 12 bytes and trivially copyable.
+ */
+class DHTHistoryRecord {
+public:
+	uint32_t timeMs;	//!< millis() value when the sample completed (DHTBackend::getMillis())
+	DHTSample sample;	//!< The sample
+};
+
+static_assert(std::is_trivially_copyable<DHTHistoryRecord>::value, "DHTHistoryRecord must be trivially copyable");
+
+/**
+ * @brief Fixed-capacity ring buffer of samples from one sensor
+ *
+ * Attach it to a sensor using DHT22Gen3::addHistory() and every completed sample for that pin is
+ * added, even if nothing else is done in the completion handler. Read the records in batches,
+ * for example to publish several samples at once instead of publishing every sample.
+ *
+ * The records are stored in a buffer you provide, so the library does not allocate memory. The
+ * easiest way is to use DHTHistoryBuffer, which contains the buffer:
+ *
+ * ```
+ * DHTHistoryBuffer<30> history;
+ * ```
+ *
+ * When the buffer is full, the oldest record is overwritten and getDroppedCount() is incremented.
+ *
+ * This class is not thread safe. Samples are added from DHT22Gen3::loop(), so read from the loop
+ * thread as well.
+ */
+class DHTHistory {
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param records Buffer to store the records in. Must remain valid for the lifetime of this object.
+	 *
+	 * @param capacity Number of records in the buffer
+	 */
+	DHTHistory(DHTHistoryRecord *records, size_t capacity) : records(records), capacity(capacity) {};
+
+	/**
+	 * @brief Only add samples that are successful (isSuccess()). Default is true.
+	 *
+	 * If false, failed samples (TOO_MANY_RETRIES, ERROR) are added as well.
+	 */
+	DHTHistory &withSuccessOnly(bool successOnly) { this->successOnly = successOnly; return *this; };
+
+	/**
+	 * @brief Adds a record, overwriting the oldest if full
+	 *
+	 * @param timeMs millis() value when the sample was taken
+	 *
+	 * @param sample The sample to add. Failed samples are ignored unless withSuccessOnly(false) is used.
+	 *
+	 * This is called by DHT22Gen3; you normally don't need to call it yourself.
+	 */
+	void add(uint32_t timeMs, const DHTSample &sample);
+
+	/**
+	 * @brief Copies up to maxRecords of the oldest records to dst and removes them
+	 *
+	 * @param dst Buffer to copy the records to, oldest first
+	 *
+	 * @param maxRecords Maximum number of records to copy
+	 *
+	 * @return Number of records copied, 0 if empty
+	 */
+	size_t read(DHTHistoryRecord *dst, size_t maxRecords);
+
+	/**
+	 * @brief Copies records to dst without removing them
+	 *
+	 * @param dst Buffer to copy the records to, oldest first
+	 *
+	 * @param maxRecords Maximum number of records to copy
+	 *
+	 * @param offset Number of the oldest records to skip
+	 *
+	 * @return Number of records copied
+	 *
+	 * Use this with discard() to only remove the records once they have been successfully sent.
+	 */
+	size_t peek(DHTHistoryRecord *dst, size_t maxRecords, size_t offset = 0) const;
+
+	/**
+	 * @brief Removes up to count of the oldest records
+	 *
+	 * @return Number of records removed
+	 */
+	size_t discard(size_t count);
+
+	/**
+	 * @brief Removes all records and clears the dropped count
+	 */
+	void clear() { head = count = 0; droppedCount = 0; };
+
+	/**
+	 * @brief Returns the number of records in the buffer
+	 */
+	size_t getCount() const { return count; };
+
+	/**
+	 * @brief Returns the maximum number of records
+	 */
+	size_t getCapacity() const { return capacity; };
+
+	/**
+	 * @brief Returns true if there are no records
+	 */
+	bool isEmpty() const { return count == 0; };
+
+	/**
+	 * @brief Returns true if the next add() will overwrite the oldest record
+	 */
+	bool isFull() const { return count >= capacity; };
+
+	/**
+	 * @brief Returns the number of records that were overwritten before they were read
+	 */
+	uint32_t getDroppedCount() const { return droppedCount; };
+
+protected:
+	DHTHistoryRecord *records; //!< Buffer of capacity records
+	size_t capacity; //!< Number of records in records
+	size_t head = 0; //!< Index into records of the oldest record
+	size_t count = 0; //!< Number of records in records
+	uint32_t droppedCount = 0; //!< Number of records overwritten before being read
+	bool successOnly = true; //!< Only add successful samples
+};
+
+/**
+ * @brief DHTHistory with a buffer of a fixed number of records inside the object
+ *
+ * Each record is 12 bytes, so DHTHistoryBuffer<30> uses about 380 bytes of RAM.
+ */
+template<size_t N>
+class DHTHistoryBuffer : public DHTHistory {
+public:
+	/**
+	 * @brief Constructor
+	 */
+	DHTHistoryBuffer() : DHTHistory(storage, N) {};
+
+protected:
+	DHTHistoryRecord storage[N]; //!< Buffer for the records
+};
+
+/**
+ * @brief Class for interfacing with one or more DHT22 sensors on a Gen3 Particle device
+ *
+ * Only allocate one of these, typically as a global variable, per device.
+ *
+ * Be sure to call the setup() and loop() methods from the actual setup and loop.
+ */
+class DHT22Gen3 {
+public:
+	/**
+	 * @brief Enumeration for possible states for the Finite State Machine
+	 */
+	enum class State {
+		IDLE_STATE,			//!< Idle, can call getSample()
+		START_STATE,		//!< Getting ready to get a sample
+		SEND_START_STATE,	//!< Sending the start bit and starting the I2S peripheral (if the backend does not time the start pulse)
+		SAMPLING_STATE		//!< Capturing samples
+	};
+
+	/**
+	 * @brief Initialize the DHT22Gen3 driver
+	 *
+	 * @param unusedPin1 An unused GPIO pin to use for SCK. It's unfortunate, but for the I2S
+	 * peripheral to work, SCK must be mapped to a valid pin. It will be set to output and
+	 * there will be 512 KHz signal output on this pin.
+	 *
+	 * @param unusedPin2 An unused GPIO pin to use for LRCK. It's unfortunate, but for the I2S
+	 * peripheral to work, LRCK must be mapped to a valid pin. It will be set to output and
+	 * there will be 32 KHz signal output on this pin. It must be a different pin than unusedPin1.
+	 *
+	 * - You will often allocate this object as a global variable.
+	 * - There can only be one per device.
+	 * - Make sure you call setup() and loop() methods from your actual setup() and loop()!
+	 */
+	DHT22Gen3(pin_t unusedPin1, pin_t unusedPin2);
+
+	/**
+	 * @brief Initialize the DHT22Gen3 driver with a specific hardware backend
+	 *
+	 * @param backend The backend to use for GPIO, clock, and capture, for example
+	 * DHTBackendNRF52Edge or DHTBackendSimulated. The object must remain valid for the lifetime of this object.
+	 *
+	 * The other constructor uses a DHTBackendNRF52, which uses the I2S peripheral.
+	 */
+	DHT22Gen3(DHTBackend *backend);
+	virtual ~DHT22Gen3();
+
+	/**
+	 * @brief Call from setup() to initialize the driver
+	 */
+	void setup();
+
+	/**
+	 * @brief Call from loop(), preferably every call to loop.
+	 *
+	 * This allows the completion function to be dispatched from normal loop execution time,
 	 * which allows normal calls like Particle.publish to be called safely.
+	 *
+	 * With withWorkerThread(), this only starts periodic samples that are due and calls the
+	 * completions of the samples the worker thread has finished.
 	 */
 	void loop();
 
+	/**
+	 * @brief Runs the sampling state machine: starts requests, sends the start pulse, decodes
+	 * the capture, and retries
+	 *
+	 * This is called by loop(), or by the worker thread with withWorkerThread(), so you don't
+	 * normally call it yourself. On a host computer, where there are no threads, you can call it
+	 * to emulate the worker thread.
+	 */
+	void process();
+
 	/**
 	 * @brief Get a sample on the specified pin
 	 *
 	 * @param dhtPin The pin the sensor is connected to (A0, A1, ..., D0, D1, ...) can also
 	 * use special pins when the port is not being use, for example, TX, RX, MISO, MOSI, SCK.
 	 *
-	 * @param completion A function or C++ lambda to call when the operation completes.
+	 * @param completion A function or C++ lambda to call when the operation completes. The
+	 * sample is passed by const reference. See DHTCompletion for the types of functions and
+	 * lambdas that can be used; they are stored without allocating memory.
 	 *
 	 * @param sensorType Optional. Default to &sensorTypeDHT22. Can also be &sensorTypeDHT11.
 	 *
 	 * This function is asynchronous and the completion function is called when done.
 	 *
-	 * Normal operation takes 24 milliseconds. If a checksum failure occurs, each retry takes
+	 * If another sample is in progress, the request is queued and is started as soon as the
+	 * previous requests complete, so you can request samples from several sensors at once. If
+	 * the queue is full, the completion is called immediately with a QUEUE_FULL result.
+	 *
+	 * Normal operation takes about 5 milliseconds for a DHT22 and 22 milliseconds for a DHT11,
+	 * mostly the start pulse (see DHTSensorType::startPulseUs) and the frame. If a checksum failure occurs, each retry takes
 	 * 2 seconds because the DHT22 cannot get new samples faster than that. So with 4 retries,
 	 * it could take about 9 seconds.
 	 */
-	void getSample(pin_t dhtPin, std::function<void(DHTSample)> completion, DHTSensorType *sensorType = &sensorTypeDHT22);
+	void getSample(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType = &sensorTypeDHT22);
+
+	/**
+	 * @brief Get a sample on the specified pin for a sensor type known at compile time
+	 *
+	 * For example, `dht.getSample<DHTTraitsDHT11>(A3, sampleCallback)`. Same as the other
+	 * getSample() but with the sensor type from the Traits class.
+	 */
+	template<class Traits>
+	void getSample(pin_t dhtPin, DHTCompletion completion) { getSample(dhtPin, completion, Traits::getSensorType()); };
+
+	/**
+	 * @brief Get a sample on the specified pin, waiting for it to complete
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param sensorType Optional. Default to &sensorTypeDHT22. Can also be &sensorTypeDHT11.
+	 *
+	 * @param timeoutMs Maximum time to wait in milliseconds. The default of 10 seconds is
+	 * enough for the default 4 tries.
+	 *
+	 * @return The sample. If it did not complete within timeoutMs, isTimeout() is true; the
+	 * request still finishes in the background but the result is discarded.
+	 *
+	 * Requires withWorkerThread(). The calling thread is blocked on a semaphore, without using
+	 * any processor time, while the worker thread gets the sample. The request is queued with
+	 * the getSample() requests, so it can return QUEUE_FULL (or BUSY with a queue depth of 0).
+	 * This can be called from any thread, including several at once. It does not depend on loop()
+	 * being called, so threads can read sensors even while the application loop is busy; finished
+	 * getSample() requests waiting for loop() to call their completion don't count against it. Without
+	 * the worker thread it returns an ERROR result immediately.
+	 *
+	 * The sample is added to the history and statistics for the pin by the calling thread, while
+	 * holding the same mutex as loop() uses to add samples from getSample(), so the two never
+	 * update them at the same time. If you read a history or statistics from a different thread
+	 * than the one updating them, a sample may be added while you read it.
+	 */
+	DHTSample readSample(pin_t dhtPin, DHTSensorType *sensorType = &sensorTypeDHT22, unsigned long timeoutMs = 10000);
+
+	/**
+	 * @brief Get a sample on the specified pin for a sensor type known at compile time, waiting
+	 * for it to complete
+	 *
+	 * For example, `dht.readSample<DHTTraitsDHT11>(A3)`. Same as the other readSample() but with
+	 * the sensor type from the Traits class.
+	 */
+	template<class Traits>
+	DHTSample readSample(pin_t dhtPin, unsigned long timeoutMs = 10000) { return readSample(dhtPin, Traits::getSensorType(), timeoutMs); };
+
+	/**
+	 * @brief Sample a sensor periodically
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param intervalMs How often to sample the sensor in milliseconds. If this is less than the
+	 * minSamplePeriodMs of the sensor type, minSamplePeriodMs is used instead.
+	 *
+	 * @param completion A function or C++ lambda to call with each sample. Called from loop() like
+	 * the getSample() completion.
+	 *
+	 * @param sensorType Optional. Default to &sensorTypeDHT22. Can also be &sensorTypeDHT11.
+	 *
+	 * @return true if added, false if DHT22GEN3_MAX_PERIODIC sensors are already scheduled.
+	 *
+	 * loop() starts the samples, so you don't need to call getSample() yourself. Samples are
+	 * taken every intervalMs without drift. The first sample of each sensor is offset from the
+	 * others so sensors added at the same time with the same interval are not all queued at once.
+	 * A sample is not started while the previous sample for the same sensor is still in progress
+	 * or while the request queue is full; it's started as soon as possible afterwards. Calling
+	 * this again for the same pin replaces the interval, completion, and sensor type; a sample
+	 * already in progress completes to the new completion.
+	 */
+	bool addPeriodicSample(pin_t dhtPin, unsigned long intervalMs, DHTCompletion completion, DHTSensorType *sensorType = &sensorTypeDHT22);
+
+	/**
+	 * @brief Stop sampling a sensor that was added with addPeriodicSample()
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @return true if removed, false if the pin was not being sampled periodically
+	 *
+	 * If a sample is in progress, it completes but the completion is not called.
+	 */
+	bool removePeriodicSample(pin_t dhtPin);
+
+	/**
+	 * @brief Only call the completion of a periodic sensor when the values change
+	 *
+	 * @param dhtPin The pin the sensor is connected to. It must already have been added using
+	 * addPeriodicSample().
+	 *
+	 * @param tempDeciC Call the completion if the temperature differs from the last one passed
+	 * to the completion by at least this many tenths of a degree C. 0 ignores temperature changes.
+	 *
+	 * @param humidityDeci Call the completion if the humidity differs from the last one passed to
+	 * the completion by at least this many tenths of a percent. 0 ignores humidity changes.
+	 *
+	 * @param maxSilenceMs Call the completion if it hasn't been called for this many milliseconds,
+	 * even if the values have not changed, so you know the sensor is still working. 0 for no limit.
+	 *
+	 * @return true if set, false if the pin is not being sampled periodically
+	 *
+	 * The values are compared to the last sample passed to the completion, not the previous
+	 * sample, so a slow drift is still reported once it adds up to the threshold. The first
+	 * sample and samples that fail are always passed to the completion. Use 0, 0, 0 to pass every
+	 * sample to the completion again, which is the default.
+	 *
+	 * Samples are still added to the history and statistics for the pin (addHistory(), addStats())
+	 * whether or not they are passed to the completion.
+	 *
+	 * The deadband only applies to the completion passed to addPeriodicSample(). Completions of
+	 * getSample() and readSample() for the same pin are always called with every sample.
+	 */
+	bool setPeriodicDeadband(pin_t dhtPin, uint16_t tempDeciC, uint16_t humidityDeci, unsigned long maxSilenceMs = 0);
+
+	/**
+	 * @brief Add every completed sample for a sensor to a history buffer
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param history The history to add to. The object must remain valid until removed.
+	 *
+	 * @return true if added, false if DHT22GEN3_MAX_SENSORS sensors already have a history, statistics, or diagnostics.
+	 *
+	 * Samples from both getSample() and addPeriodicSample() are added, before the completion is
+	 * called. Calling this again for the same pin replaces the history.
+	 */
+	bool addHistory(pin_t dhtPin, DHTHistory *history);
+
+	/**
+	 * @brief Stop adding samples for a sensor to its history
+	 *
+	 * @return true if removed, false if the pin did not have a history
+	 */
+	bool removeHistory(pin_t dhtPin);
 
 	/**
-	 * @brief Returns true if you can call getSample(). Returns false if another call is still in progress.
+	 * @brief Returns the history attached to a pin using addHistory(), or 0 if none
+	 *
+	 * This can be called from any thread.
+	 */
+	DHTHistory *getHistory(pin_t dhtPin) const;
+
+	/**
+	 * @brief Add every successful sample for a sensor to running statistics
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param stats The statistics to update. The object must remain valid until removed.
+	 *
+	 * @return true if added, false if DHT22GEN3_MAX_SENSORS sensors already have a history, statistics, or diagnostics.
+	 *
+	 * Samples from both getSample() and addPeriodicSample() are added, before the completion is
+	 * called, so the completion can query the statistics including the new sample. Calling this
+	 * again for the same pin replaces the statistics.
+	 */
+	bool addStats(pin_t dhtPin, DHTSensorStats *stats);
+
+	/**
+	 * @brief Stop updating the statistics for a sensor
+	 *
+	 * @return true if removed, false if the pin did not have statistics
 	 */
-	bool canGetSample() const { return state == State::IDLE_STATE; };
+	bool removeStats(pin_t dhtPin);
+
+	/**
+	 * @brief Returns the statistics attached to a pin using addStats(), or 0 if none
+	 *
+	 * This can be called from any thread.
+	 */
+	DHTSensorStats *getStats(pin_t dhtPin) const;
+
+	/**
+	 * @brief Record decode timing and quality for a sensor
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param diagnostics The object to update. The object must remain valid until removed.
+	 *
+	 * @return true if added, false if DHT22GEN3_MAX_SENSORS sensors already have a history, statistics, or diagnostics.
+	 *
+	 * Every frame decoded for the pin is added, including ones that fail and are retried. The
+	 * timing of the most recent frame is in diagnostics->lastFrame. Sensors without diagnostics
+	 * are decoded without recording any timing.
+	 */
+	bool addDiagnostics(pin_t dhtPin, DHTSensorDiagnostics *diagnostics);
+
+	/**
+	 * @brief Stop recording decode diagnostics for a sensor
+	 *
+	 * @return true if removed, false if the pin did not have diagnostics
+	 */
+	bool removeDiagnostics(pin_t dhtPin);
+
+	/**
+	 * @brief Returns the diagnostics attached to a pin using addDiagnostics(), or 0 if none
+	 *
+	 * This can be called from any thread.
+	 */
+	DHTSensorDiagnostics *getDiagnostics(pin_t dhtPin) const;
+
+	/**
+	 * @brief Returns true if you can call getSample(). Returns false if another call is still in
+	 * progress and the request queue is full.
+	 */
+	bool canGetSample() const { return workerThread ? (activeCount <= queueDepth && pendingCount <= queueDepth) : ((state == State::IDLE_STATE && queueCount == 0) || queueCount < queueDepth); };
+
+	/**
+	 * @brief Returns the number of requests waiting in the queue, not including the one in progress
+	 */
+	size_t getQueueCount() const { return queueCount; };
+
+	/**
+	 * @brief Gets the measured length of the last start pulse, in microseconds
+	 *
+	 * The start pulse should be the startPulseUs of the sensor type (1.1 milliseconds for the
+	 * DHT22, 18 milliseconds for the DHT11). With the default nRF52 backend it's timed by a
+	 * hardware timer and this is the time until the interrupt released the line. Otherwise
+	 * it's timed by calls to loop() and will be longer if loop() is not called frequently.
+	 */
+	uint32_t getLastStartPulseUs() const { return lastStartPulseUs; };
+
+	/**
+	 * @brief Gets the backend used for GPIO, clock, and capture
+	 *
+	 * If you used the DHT22Gen3(unusedPin1, unusedPin2) constructor, this is a DHTBackendNRF52.
+	 */
+	DHTBackend *getBackend() const { return backend; };
 
 	/**
 	 * @brief Gets the last result if you want to poll instead of use the completion function.
@@ -343,8 +1259,80 @@ public:
 	 * @brief Maximum number of attempts to get a valid result (passes checksum). Default is 4.
 	 *
 	 * Note that each retry takes 2.25 seconds, so you may not want to set the value too high.
+	 * Values larger than DHTSample::MAX_TRIES (15) are limited to 15.
+	 */
+	DHT22Gen3 &withMaxTries(int tries) { this->maxTries = (tries < DHTSample::MAX_TRIES) ? tries : DHTSample::MAX_TRIES; return *this; };
+
+	/**
+	 * @brief Number of getSample() requests that can wait while another is in progress. Default is
+	 * DHT22GEN3_MAX_QUEUE_DEPTH (8).
+	 *
+	 * @param depth Queue depth, 0 to DHT22GEN3_MAX_QUEUE_DEPTH. Values larger than the maximum are
+	 * limited to the maximum. 0 disables queuing and getSample() returns BUSY if a sample is
+	 * already in progress, the behavior of earlier versions of this library.
 	 */
-	DHT22Gen3 &withMaxTries(int tries) { this->maxTries = tries; return *this; };
+	DHT22Gen3 &withQueueDepth(size_t depth);
+
+	/**
+	 * @brief Find the threshold between 0 and 1 bits from the pulse widths of each frame. Default is false.
+	 *
+	 * @param adaptive true to enable, false to always use the oneBitThreshold of the sensor type.
+	 *
+	 * Long cables, weak pull-ups, and some clone sensors shift the pulse widths enough that the
+	 * fixed threshold occasionally decodes a bit incorrectly, and each checksum failure costs a
+	 * retry after minSamplePeriodMs. When enabled, the high periods of each complete frame are
+	 * split into two clusters and the bits are decoded using the midpoint between them (see
+	 * DHTDecoder::findThreshold()). The last threshold that produced a valid checksum is saved for
+	 * each pin and used when a frame cannot be clustered. If the checksum fails with the adaptive
+	 * threshold, the fixed threshold of the sensor type is tried before retrying.
+	 *
+	 * The threshold used is available in the decode diagnostics (see addDiagnostics()).
+	 */
+	DHT22Gen3 &withAdaptiveThreshold(bool adaptive = true) { this->adaptiveThreshold = adaptive; return *this; };
+
+	/**
+	 * @brief Fix frames with an invalid checksum caused by one marginal bit. Default is 0 (disabled).
+	 *
+	 * @param maxMarginUs Only bits whose high period is within this many microseconds of the
+	 * 0/1 threshold may be flipped. 8 is one sample at 128 kHz. 0 disables repair.
+	 *
+	 * A bit whose high period is very close to the threshold is the most likely one to be wrong.
+	 * When the checksum is not valid, if flipping exactly one of the least confident bits makes it
+	 * valid, that bit is flipped and the sample succeeds with isRepaired() set, instead of waiting
+	 * minSamplePeriodMs (2 seconds for the DHT22) to retry. If several bits are equally likely the
+	 * frame is retried as usual. The checksum is only 8 bits, so a repaired sample is slightly more
+	 * likely to be wrong than one that passed the checksum without repair.
+	 */
+	DHT22Gen3 &withChecksumRepair(uint16_t maxMarginUs = 8) { this->repairMarginUs = maxMarginUs; return *this; };
+
+	/**
+	 * @brief Run the state machine in a worker thread instead of from loop(). Default is false.
+	 *
+	 * Call before setup(). Normally the end of a capture is only noticed the next time loop() is
+	 * called, so if your loop() is busy (for example, with cloud operations) each sample takes
+	 * that much longer. With the worker thread, the capture interrupt wakes the thread, which
+	 * decodes the frame as soon as it's complete and posts the finished sample to a lock-free
+	 * queue (DHTQueue). loop() only calls the completions, so they still run on the application
+	 * thread and can use Particle.publish() and other functions safely.
+	 *
+	 * The worker thread uses DHT22GEN3_WORKER_STACK_SIZE bytes of stack and runs at
+	 * DHT22GEN3_WORKER_PRIORITY. While a capture is in progress it also runs every millisecond
+	 * for the timeouts and, if the backend does not time the start pulse, the start pulse. While
+	 * waiting for the minimum sample period of a sensor it sleeps until the sensor can be read.
+	 *
+	 * - getSample() can be called from any thread, but its completion is called from loop().
+	 * - readSample() waits for a sample from any thread, see readSample().
+	 * - Call addPeriodicSample() and the other periodic functions from the application thread only.
+	 * - Histories and statistics are updated from loop(), before the completion is called, or by
+	 * the thread calling readSample().
+	 * - Decode diagnostics are updated by the worker thread. addDiagnostics() and
+	 * removeDiagnostics() can be called at any time; once removeDiagnostics() returns, the worker
+	 * no longer uses the object. Reading it while a frame is being added is not synchronized.
+	 * - getLastResult() and getLastStartPulseUs() are updated by the worker thread.
+	 *
+	 * If the thread cannot be created, loop() runs the state machine as usual.
+	 */
+	DHT22Gen3 &withWorkerThread(bool enable = true) { this->workerThread = enable; return *this; };
 
 	/**
 	 * @brief Pass a pointer to sensorTypeDHT11 to getSamples() for DHT11 sensors
@@ -357,25 +1345,277 @@ public:
 	static DHTSensorTypeDHT22 sensorTypeDHT22;
 
 protected:
+	/**
+	 * @brief A getSample() request waiting in the queue
+	 */
+	class Request {
+	public:
+		pin_t dhtPin = 0; //!< Pin the sensor is connected to
+		DHTSensorType *sensorType = 0; //!< Sensor type
+		DHTCompletion completion; //!< Completion handler function or lambda. May be empty.
+		bool onWorker = false; //!< Call the completion on the worker thread instead of from loop(). Used by readSample().
+	};
+
+	/**
+	 * @brief A thread waiting in readSample()
+	 */
+	class Waiter {
+	public:
+		os_semaphore_t semaphore = 0; //!< Given by finishRead() when the sample is done
+		bool inUse = false; //!< A readSample() request using this entry has not finished
+		bool done = false; //!< sample has been set
+		bool abandoned = false; //!< readSample() timed out, so finishRead() releases the entry
+		DHTSample sample; //!< The result
+	};
+
+	/**
+	 * @brief A sample finished by the worker thread, waiting for loop() to call the completion
+	 */
+	class Completed {
+	public:
+		pin_t dhtPin = 0; //!< Pin the sensor is connected to
+		DHTSample sample; //!< The result
+		DHTCompletion completion; //!< Completion handler function or lambda. May be empty.
+	};
+
+	/**
+	 * @brief Information kept for each sensor (pin)
+	 */
+	class SensorInfo {
+	public:
+		bool inUse = false; //!< True if this entry is assigned to dhtPin
+		pin_t dhtPin = 0; //!< Pin the sensor is connected to
+		unsigned long lastRequestTime = 0; //!< millis() value at last request on this pin. Used to prevent querying more often than minSamplePeriodMs (2 seconds)
+		const DHTSensorType *thresholdType = 0; //!< Sensor type learnedThreshold was found with, see withAdaptiveThreshold()
+		int learnedThreshold = 0; //!< Last adaptive threshold that produced a valid checksum
+	};
+
+	/**
+	 * @brief A sensor sampled periodically, see addPeriodicSample()
+	 */
+	class Periodic {
+	public:
+		bool inUse = false; //!< True if this entry is used
+		bool pending = false; //!< A sample has been requested and has not completed yet
+		uint32_t generation = 0; //!< Changes each time the entry is added, so completions of samples requested before it was removed are ignored
+		pin_t dhtPin = 0; //!< Pin the sensor is connected to
+		DHTSensorType *sensorType = 0; //!< Sensor type
+		unsigned long intervalMs = 0; //!< Sample period in milliseconds
+		unsigned long nextTime = 0; //!< millis() value when the next sample is due
+		DHTCompletion completion; //!< Completion handler function or lambda. May be empty.
+
+		/**
+		 * @brief Returns true if the sample should be passed to the completion, see setPeriodicDeadband()
+		 *
+		 * If true, the sample is saved as the last one reported.
+		 */
+		bool checkDeadband(const DHTSample &sample, unsigned long now);
+
+		uint16_t deadbandTempDeciC = 0; //!< Minimum temperature change to report, 0 to ignore
+		uint16_t deadbandHumidityDeci = 0; //!< Minimum humidity change to report, 0 to ignore
+		unsigned long maxSilenceMs = 0; //!< Maximum time between reports, 0 for no limit
+		bool hasReported = false; //!< A successful sample has been passed to the completion
+		int16_t reportedTempDeciC = 0; //!< Temperature of the last sample passed to the completion
+		int16_t reportedHumidityDeci = 0; //!< Humidity of the last sample passed to the completion
+		unsigned long reportedTime = 0; //!< millis() value when the last sample was passed to the completion
+	};
+
+	/**
+	 * @brief Objects attached to a sensor that samples are added to, see addHistory(), addStats(), and addDiagnostics()
+	 */
+	class Attachment {
+	public:
+		/**
+		 * @brief Returns true if anything is attached
+		 */
+		bool inUse() const { return history || stats || diagnostics; };
+
+		pin_t dhtPin = 0; //!< Pin the sensor is connected to
+		DHTHistory *history = 0; //!< History to add samples to, or 0 if none
+		DHTSensorStats *stats = 0; //!< Statistics to add successful samples to, or 0 if none
+		DHTSensorDiagnostics *diagnostics = 0; //!< Decode diagnostics to add each frame to, or 0 if none
+	};
+
+	/**
+	 * @brief Used internally to find the attachments for a pin. Call with requestMutex locked.
+	 *
+	 * @param dhtPin The pin to look up
+	 *
+	 * @param create If true and there is no entry for dhtPin, an unused one is assigned
+	 *
+	 * @return The entry, or 0 if not found and create is false, or if all entries are in use
+	 */
+	Attachment *findAttachment(pin_t dhtPin, bool create);
+
+	/**
+	 * @brief Used internally to add a result to the history and statistics for a pin
+	 */
+	void updateAttachments(pin_t dhtPin, const DHTSample &sample);
+
+	/**
+	 * @brief Used internally to set up decoder for a capture that is starting
+	 */
+	void startDecoder();
+
+	/**
+	 * @brief Used internally to decode the words or edges captured since the last call
+	 */
+	void updateDecoder();
+
+	/**
+	 * @brief Used internally to find the per-sensor information for a pin
+	 *
+	 * @param dhtPin The pin to look up
+	 *
+	 * @param create If true and there is no entry for dhtPin, one is assigned. If all entries are
+	 * in use, the least recently used one is reused.
+	 *
+	 * @return The entry, or 0 if not found and create is false.
+	 */
+	SensorInfo *findSensor(pin_t dhtPin, bool create);
+
+	/**
+	 * @brief Used internally to determine if the sensor on a pin can be queried now
+	 *
+	 * Returns false if it's been less than minSamplePeriodMs since the last request on the same pin.
+	 */
+	bool isSensorReady(pin_t dhtPin, const DHTSensorType *sensorType);
+
+	/**
+	 * @brief Used internally to start samples for periodic sensors that are due, called from loop()
+	 */
+	void checkPeriodic();
+
+	/**
+	 * @brief Used internally as the completion handler for samples started by checkPeriodic()
+	 *
+	 * @param index Index into periodic
+	 *
+	 * @param generation The generation of the entry when the sample was requested. If the entry has
+	 * been removed (and possibly reused) since then, the sample is ignored.
+	 *
+	 * @param sample The sample
+	 */
+	void periodicCompletion(size_t index, uint32_t generation, const DHTSample &sample);
+
 	/**
 	 * @brief Used internally to call the completion handler
 	 *
-	 * Goes into IDLE state after calling the completion
+	 * Goes into IDLE state after calling the completion, then starts the next queued request, if any.
+	 * With the worker thread, the completion is posted to completedQueue instead of being called.
 	 */
 	void callCompletion(DHTSample::SampleResult sampleResult);
 
-	pin_t unusedPin1; //!< Pin to output SCK (not used by DHT22, but unfortunately required by I2S)
-	pin_t unusedPin2; //!< Pin to output LRCK (not used by DHT22, but unfortunately required by I2S)
+	/**
+	 * @brief Used internally to add a request to the queue or start it, the part of getSample()
+	 * that runs on the worker thread
+	 */
+	void addRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker = false);
+
+	/**
+	 * @brief Used internally to call a completion for a request that could not be queued
+	 */
+	void rejectRequest(pin_t dhtPin, DHTCompletion completion, const DHTSample &sample, bool onWorker = false);
+
+	/**
+	 * @brief Used internally to post a request to the worker thread. Call with requestMutex locked.
+	 *
+	 * @return false if too many requests are pending
+	 */
+	bool postRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker);
+
+	/**
+	 * @brief Used internally as the completion of readSample(), called on the worker thread
+	 */
+	void finishRead(Waiter *waiter, const DHTSample &sample);
+
+	/**
+	 * @brief Used internally to lock requestMutex, if it has been created
+	 */
+	void lockRequests() const;
+
+	/**
+	 * @brief Used internally to unlock requestMutex, if it has been created
+	 */
+	void unlockRequests() const;
+
+	/**
+	 * @brief Used internally to wake the worker thread
+	 */
+	void wakeWorker();
+
+	/**
+	 * @brief Used internally to get how long the worker thread can sleep before process() has work to do
+	 *
+	 * @return Milliseconds, or CONCURRENT_WAIT_FOREVER if idle
+	 */
+	system_tick_t getWorkerTimeout();
+
+	/**
+	 * @brief The worker thread function. Calls process() when woken by wakeWorker().
+	 */
+	static os_thread_return_t workerThreadFunction(void *param);
+
+	/**
+	 * @brief Capture handler set on the backend, called from the capture interrupt
+	 */
+	static void workerCaptureHandler(void *context);
+
+	/**
+	 * @brief Used internally to make a request the one in progress and go into START_STATE
+	 */
+	void startRequest(pin_t dhtPin, DHTCompletion completion, DHTSensorType *sensorType, bool onWorker = false);
+
+	/**
+	 * @brief Used internally to start a queued request if in IDLE_STATE
+	 *
+	 * The oldest request for a sensor that can be queried now is started. If all sensors with
+	 * queued requests were queried too recently, the oldest request is started and waits in
+	 * START_STATE.
+	 */
+	void startNextRequest();
+
+	DHTBackendNRF52 nrf52Backend; //!< Backend used by the DHT22Gen3(unusedPin1, unusedPin2) constructor
+	DHTBackend *backend; //!< Backend for GPIO, clock, and capture
 
 	pin_t dhtPin = 0; //!< Pin to communicate with DHT22. Set by getSample()
 	DHTSensorType *sensorType = &sensorTypeDHT22; //!< Sensor type, optional parameter to getSample();
 
-	unsigned long lastRequestTime = 0; //!< millis() value at last request. Used to prevent querying more often than minSamplePeriodMs (2 seconds)
+	SensorInfo *curSensor = 0; //!< Per-sensor information for dhtPin. Set by getSample().
+	SensorInfo sensors[DHT22GEN3_MAX_SENSORS]; //!< Per-sensor information, see findSensor()
 	unsigned long stateTime = 0; //!< millis() value used with state transitions
+	unsigned long startPulseMicros = 0; //!< micros() value when the start pulse started
+	uint32_t lastStartPulseUs = 0; //!< Measured length of the last start pulse
+	unsigned long samplingTimeoutMs = 0; //!< Maximum time to stay in SAMPLING_STATE
 	int 	maxTries = 4; //!< Maximum number of retries on checksum values. Default is 4. Each retry takes 2.5 seconds.
+	bool adaptiveThreshold = false; //!< Find the 0/1 bit threshold from each frame. Set by withAdaptiveThreshold().
+	uint16_t repairMarginUs = 0; //!< Maximum margin of a bit flipped by checksum repair, 0 to disable. Set by withChecksumRepair().
 	State state = State::IDLE_STATE; //!< State of the finite state machine.
-	DHTSample result; //!< Result that will be passed to the callback (by value)
-	std::function<void(DHTSample)> completion = 0; //!< Completion handler function or lambda. Set by getSample(). May be 0.
+	DHTSample result; //!< Result that will be passed to the callback
+	DHTCompletion completion; //!< Completion handler function or lambda. Set by getSample(). May be empty.
+	bool completionOnWorker = false; //!< Call completion on the worker thread, see Request::onWorker
+	DHTDecoder decoder; //!< Decodes the capture while it's in progress, see updateDecoder()
+	size_t decodedCount = 0; //!< Number of words or edges of the capture already passed to decoder
+
+	Request queue[DHT22GEN3_MAX_QUEUE_DEPTH]; //!< Circular buffer of requests waiting to be started
+	size_t queueHead = 0; //!< Index into queue of the oldest request
+	size_t queueCount = 0; //!< Number of requests in queue
+	size_t queueDepth = DHT22GEN3_MAX_QUEUE_DEPTH; //!< Number of entries of queue that may be used. Set by withQueueDepth().
+
+	bool workerThread = false; //!< Run process() on a worker thread. Set by withWorkerThread().
+	os_thread_t worker = 0; //!< Worker thread, or 0 if not created
+	os_semaphore_t workerSemaphore = 0; //!< Given to wake the worker thread
+	DHTQueue<Request, DHT22GEN3_MAX_QUEUE_DEPTH + 1> requestQueue; //!< getSample() requests from the application thread to the worker
+	DHTQueue<Completed, DHT22GEN3_MAX_QUEUE_DEPTH + 1> completedQueue; //!< Finished samples from the worker to loop()
+	std::atomic<size_t> activeCount{0}; //!< Requests posted to requestQueue that the worker has not finished yet
+	std::atomic<size_t> pendingCount{0}; //!< getSample() requests posted to requestQueue whose completion has not been called by loop() yet
+	os_mutex_t requestMutex = 0; //!< Serializes threads posting to requestQueue and the Waiter entries
+	Waiter waiters[DHT22GEN3_MAX_QUEUE_DEPTH + 1]; //!< Threads waiting in readSample()
+
+	Periodic periodic[DHT22GEN3_MAX_PERIODIC]; //!< Sensors sampled periodically, see addPeriodicSample()
+	uint32_t periodicGeneration = 0; //!< Generation of the most recently added periodic entry
+
+	Attachment attachments[DHT22GEN3_MAX_SENSORS]; //!< Histories and statistics attached to sensors
 };
 
 
@@ -0,0 +1,573 @@
+#ifndef _DHTBACKEND_H
+#define _DHTBACKEND_H
+
+#include "Particle.h"
+
+#include "DHTCaptureSynth.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+/**
+ * @brief Maximum number of 16-bit words in the capture buffer
+ *
+ * The buffer is statically allocated by the backend and must be large enough for the numWords of
+ * the DHTCaptureConfig of every sensor type you use. The built-in DHT11 and DHT22 types, and
+ * custom types created with the 3-parameter DHTSensorType constructor, need 46. Sensor types
+ * using DHTCaptureConfig::CONFIG_512K need 180; the capture fails if the buffer is too small.
+ *
+ * This and DHT22GEN3_MAX_EDGES are fixed library constants. They size the buffer in
+ * DHTBackendSimulated as well as the static buffers in the nRF52 backends, so the library and
+ * every file that includes this header must agree on them; don't define them before including it.
+ */
+#define DHT22GEN3_MAX_CAPTURE_WORDS 46
+
+/**
+ * @brief Maximum number of edge timestamps captured by edge capture backends
+ *
+ * A complete frame is 84 edges.
+ */
+#define DHT22GEN3_MAX_EDGES 88
+
+/**
+ * @brief How to capture the data line, part of the DHTSensorType
+ *
+ * The I2S peripheral is used with 16-bit stereo samples, so the sample rate (bits per second) is
+ * 32 MHz / mckDivider / ratio * 32.
+ */
+class DHTCaptureConfig {
+public:
+	/**
+	 * @brief Returns the number of samples per second
+	 */
+	uint32_t getSampleRate() const { return (uint32_t)(32000000ULL * 32 / ((uint32_t)mckDivider * ratio)); };
+
+	uint8_t mckDivider;		//!< MCK is 32 MHz divided by this. One of 8, 10, 11, 15, 16, 21, 23, 30, 31, 32, 42, 63, 125.
+	uint16_t ratio;			//!< MCK to LRCK ratio. One of 32, 48, 64, 96, 128, 192, 256, 384, 512.
+	uint16_t numWords;		//!< Number of 16-bit words to capture (must be even). At least 5.6 ms of samples is required.
+
+	/**
+	 * @brief 508 kHz, 180 words. This is what versions 0.0.4 and earlier used for all sensors.
+	 */
+	static const DHTCaptureConfig CONFIG_512K;
+
+	/**
+	 * @brief 128 kHz, 46 words. Used by the built-in DHT11 and DHT22 sensor types.
+	 */
+	static const DHTCaptureConfig CONFIG_128K;
+};
+
+/**
+ * @brief Hardware interface used by DHT22Gen3
+ *
+ * DHT22Gen3 does all of its GPIO, clock, and capture peripheral access through this interface so
+ * the state machine can run against something other than the real hardware.
+ *
+ * - DHTBackendNRF52 uses the nRF52 I2S peripheral. This is what you get when you construct
+ * DHT22Gen3 with two unused pins.
+ * - DHTBackendNRF52Edge records the time of each edge using GPIOTE, PPI, and a timer, and does not
+ * require the unused pins.
+ * - DHTBackendSimulated synthesizes sensor waveforms into the capture buffer, so you can test
+ * queueing, retries, and latency without sensors.
+ *
+ * The capture is either a buffer of 16-bit words, most significant bit first, one bit per sample
+ * of the data line, or if capturesEdges() returns true, a buffer of edge timestamps in
+ * microseconds. Both are decoded by DHTDecoder.
+ */
+class DHTBackend {
+public:
+	/**
+	 * @brief Number of edges in a complete frame, for backends that capture edges
+	 *
+	 * All 40 bits have been received after EDGES_PER_FRAME - 1 edges. The last edge is the sensor
+	 * releasing the line about 50 microseconds later, so a capture stopped as soon as the frame
+	 * has been decoded may not include it.
+	 */
+	static const size_t EDGES_PER_FRAME = 84;
+
+	/**
+	 * @brief Destructor
+	 */
+	virtual ~DHTBackend() {};
+
+	/**
+	 * @brief Called from DHT22Gen3::setup()
+	 */
+	virtual void setup() {};
+
+	/**
+	 * @brief Clock: returns the number of milliseconds since startup, like millis()
+	 */
+	virtual unsigned long getMillis() { return millis(); };
+
+	/**
+	 * @brief Clock: returns the number of microseconds since startup, like micros()
+	 */
+	virtual unsigned long getMicros() { return micros(); };
+
+	/**
+	 * @brief GPIO: sets the pin mode, like pinMode()
+	 */
+	virtual void setPinMode(pin_t pin, PinMode mode) { pinMode(pin, mode); };
+
+	/**
+	 * @brief GPIO: sets the output value of a pin, like digitalWrite()
+	 */
+	virtual void writePin(pin_t pin, uint8_t value) { digitalWrite(pin, value); };
+
+	/**
+	 * @brief Capture: called before the start pulse is sent
+	 *
+	 * Anything slow should be done here, not in startCapture(), because startCapture() must
+	 * begin capturing within 20 microseconds of the start pulse ending.
+	 */
+	virtual void prepareCapture() {};
+
+	/**
+	 * @brief Capture: start capturing the data line
+	 *
+	 * @param dhtPin The pin the sensor is connected to. It has already been set to INPUT.
+	 *
+	 * @param config The sample rate and number of words to capture
+	 *
+	 * @return true on success or false if the capture could not be started.
+	 */
+	virtual bool startCapture(pin_t dhtPin, const DHTCaptureConfig &config) = 0;
+
+	/**
+	 * @brief Capture: returns true if the backend can send the start pulse and start the capture
+	 * itself using startTimedCapture()
+	 *
+	 * If false, DHT22Gen3 sends the start pulse using setPinMode() and writePin(), timed by calls
+	 * to loop(), then calls startCapture().
+	 */
+	virtual bool hasTimedStart() const { return false; };
+
+	/**
+	 * @brief Capture: send the start pulse and start capturing, timed by the backend
+	 *
+	 * @param dhtPin The pin the sensor is connected to
+	 *
+	 * @param pulseUs Length of the start pulse (low period) in microseconds
+	 *
+	 * @param config The sample rate and number of words to capture
+	 *
+	 * Drives dhtPin low, and after pulseUs releases it (INPUT) and starts capturing. This must
+	 * not depend on how often DHT22Gen3::loop() is called, for example it can be done from a
+	 * hardware timer interrupt. Returns immediately; use isCaptureComplete() to find out when the
+	 * capture is done. Only called if hasTimedStart() returns true.
+	 *
+	 * @return true on success or false if the pulse could not be started.
+	 */
+	virtual bool startTimedCapture(pin_t /* dhtPin */, uint32_t /* pulseUs */, const DHTCaptureConfig & /* config */) { return false; };
+
+	/**
+	 * @brief Capture: returns the measured length of the last start pulse sent by
+	 * startTimedCapture() in microseconds
+	 */
+	virtual uint32_t getLastStartPulseUs() const { return 0; };
+
+	/**
+	 * @brief Capture: returns true if the capture buffer has been filled
+	 */
+	virtual bool isCaptureComplete() = 0;
+
+	/**
+	 * @brief Capture: returns the number of words at the start of getCaptureBuffer() that have
+	 * been captured so far
+	 *
+	 * DHT22Gen3 calls this while the capture is in progress to decode the frame as it arrives,
+	 * and stops the capture as soon as all 40 bits have been received. The default implementation
+	 * returns getCaptureWords() once isCaptureComplete() is true, and 0 before that, for backends
+	 * that can only provide the whole buffer.
+	 */
+	virtual size_t getCapturedWords() { return isCaptureComplete() ? getCaptureWords() : 0; };
+
+	/**
+	 * @brief Capture: stop capturing and release the peripheral
+	 *
+	 * This may be called before isCaptureComplete() is true, when the frame has already been
+	 * received or on timeout.
+	 *
+	 * @return true if the capture buffer was filled or getCapturedWords() words were captured
+	 * before stopping, false if the capture failed. Edge capture backends also return true if
+	 * the capture was stopped after EDGES_PER_FRAME - 1 edges, when the frame is complete.
+	 */
+	virtual bool stopCapture() = 0;
+
+	/**
+	 * @brief Capture: returns the capture buffer. Valid after stopCapture() returns true.
+	 */
+	virtual const uint16_t *getCaptureBuffer() const = 0;
+
+	/**
+	 * @brief Capture: returns the number of 16-bit words captured, normally the numWords in the
+	 * DHTCaptureConfig passed to startCapture()
+	 */
+	virtual size_t getCaptureWords() const = 0;
+
+	/**
+	 * @brief Capture: returns true if the backend captures edge timestamps instead of samples
+	 *
+	 * If true, DHT22Gen3 decodes getEdgeBuffer() using the oneBitThresholdUs of the sensor type
+	 * instead of getCaptureBuffer().
+	 */
+	virtual bool capturesEdges() const { return false; };
+
+	/**
+	 * @brief Capture: returns the time of each edge in microseconds since the line was released
+	 * after the start pulse. Valid after stopCapture() returns true.
+	 */
+	virtual const uint16_t *getEdgeBuffer() const { return 0; };
+
+	/**
+	 * @brief Capture: returns the number of edges in getEdgeBuffer()
+	 *
+	 * This is also called while the capture is in progress, so it must only include edges that
+	 * have already been stored in the buffer, and must be 0 until the line is released.
+	 */
+	virtual size_t getEdgeCount() const { return 0; };
+
+	/**
+	 * @brief Capture: sets a function to call from the capture interrupt when more of the capture
+	 * is available and when it's complete
+	 *
+	 * @param handler The function to call, or 0 for none. It's called from an interrupt handler,
+	 * so it must be short and must not allocate memory or block.
+	 *
+	 * @param context Passed to handler
+	 *
+	 * Used by DHT22Gen3::withWorkerThread() to wake the worker thread as soon as there is
+	 * something to decode. The default implementation ignores it, for backends without interrupts.
+	 */
+	virtual void setCaptureHandler(void (* /* handler */)(void *context), void * /* context */) {};
+};
+
+/**
+ * @brief Backend using the nRF52 I2S peripheral as a DMA-based signal sampler
+ *
+ * The I2S peripheral samples the data line at the rate set by the DHTCaptureConfig of the sensor
+ * type (128 kHz for the built-in types) into a DHT22GEN3_MAX_CAPTURE_WORDS word buffer.
+ *
+ * By default, the start pulse is timed by a hardware timer (DHT22GEN3_TIMER, TIMER4 by default)
+ * and the data line is released and the I2S peripheral started from its interrupt handler, so the
+ * pulse length does not depend on how often loop() is called. This can be disabled using
+ * withTimedStart(false).
+ *
+ * The buffer is captured in pieces chained by the I2S EasyDMA, so DHT22Gen3 can decode the frame
+ * while it's arriving and stop the peripheral as soon as the last bit is received, instead of
+ * always capturing the whole buffer. Each piece is 1 ms of samples, up to
+ * DHT22GEN3_CAPTURE_CHUNK_WORDS (8). For the 128 kHz captures of the built-in sensor types that's
+ * 8 words, an interrupt every millisecond. If the driver ever has to reuse a piece because the
+ * next one wasn't set in time, the capture fails instead of returning overwritten samples.
+ *
+ * By default, the I2S peripheral is initialized once in setup() and only the SDIN pin selection is
+ * changed for each sample, which reduces the setup time between releasing the data line and the
+ * capture starting. Use withPersistentPeripheral(false) to initialize and uninitialize it for
+ * every sample instead.
+ */
+class DHTBackendNRF52 : public DHTBackend {
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param unusedPin1 An unused GPIO pin to use for SCK. See DHT22Gen3::DHT22Gen3().
+	 *
+	 * @param unusedPin2 An unused GPIO pin to use for LRCK. See DHT22Gen3::DHT22Gen3().
+	 */
+	DHTBackendNRF52(pin_t unusedPin1, pin_t unusedPin2) : unusedPin1(unusedPin1), unusedPin2(unusedPin2) {};
+
+	/**
+	 * @brief Use a hardware timer to time the start pulse. Default is true.
+	 *
+	 * Call before DHT22Gen3::setup().
+	 */
+	DHTBackendNRF52 &withTimedStart(bool timedStart) { this->timedStart = timedStart; return *this; };
+
+	/**
+	 * @brief Keep the I2S peripheral initialized between samples. Default is true.
+	 *
+	 * Call before DHT22Gen3::setup().
+	 */
+	DHTBackendNRF52 &withPersistentPeripheral(bool persistentPeripheral) { this->persistentPeripheral = persistentPeripheral; return *this; };
+
+	/**
+	 * @brief Returns the time in microseconds spent configuring the I2S peripheral for the last sample
+	 *
+	 * This is the per-sample overhead before the capture can start. It's much smaller with
+	 * withPersistentPeripheral(true).
+	 */
+	uint32_t getLastCaptureSetupUs() const { return lastCaptureSetupUs; };
+
+	virtual void setup();
+	virtual void prepareCapture();
+	virtual bool startCapture(pin_t dhtPin, const DHTCaptureConfig &config);
+	virtual bool hasTimedStart() const { return timedStart; };
+	virtual bool startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config);
+	virtual uint32_t getLastStartPulseUs() const;
+	virtual bool isCaptureComplete();
+	virtual size_t getCapturedWords();
+	virtual bool stopCapture();
+	virtual const uint16_t *getCaptureBuffer() const;
+	virtual size_t getCaptureWords() const;
+	virtual void setCaptureHandler(void (*handler)(void *context), void *context);
+
+protected:
+	/**
+	 * @brief Used internally to initialize the I2S peripheral for a sample, but not start it
+	 *
+	 * @param dhtPin The pin to capture, or PIN_INVALID to initialize without connecting SDIN
+	 *
+	 * @param config The sample rate and number of words to capture
+	 */
+	bool initI2S(pin_t dhtPin, const DHTCaptureConfig &config);
+
+	/**
+	 * @brief Used internally to uninitialize the I2S peripheral
+	 */
+	void uninitI2S();
+
+	pin_t unusedPin1; //!< Pin to output SCK (not used by DHT22, but unfortunately required by I2S)
+	pin_t unusedPin2; //!< Pin to output LRCK (not used by DHT22, but unfortunately required by I2S)
+	bool timedStart = true; //!< Use a hardware timer for the start pulse
+	bool persistentPeripheral = true; //!< Initialize the I2S peripheral once instead of every sample
+	DHTCaptureConfig config = DHTCaptureConfig::CONFIG_128K; //!< Configuration of the current or last capture
+	uint32_t lastCaptureSetupUs = 0; //!< Time spent in initI2S() for the last sample
+};
+
+/**
+ * @brief Backend that captures the time of each edge of the data line
+ *
+ * Instead of oversampling the line, a GPIOTE channel generates an event on each edge of the data
+ * line. A PPI channel connects the event to a capture task of the timer used for the start pulse
+ * (DHT22GEN3_TIMER), and forks to an EGU (DHT22GEN3_EGU) whose interrupt copies the captured time
+ * to the edge buffer. A frame is 84 edges, stored as 16-bit microsecond values (176 bytes with
+ * the default DHT22GEN3_MAX_EDGES), and decoding is one subtraction and comparison per edge.
+ *
+ * Unlike DHTBackendNRF52, no pins are used for clock outputs, and nothing is output while not
+ * sampling. The start pulse is always timed by the timer.
+ *
+ * The capture register is read from the EGU interrupt, so an edge is lost if that interrupt is
+ * delayed by more than the shortest period (about 25 us), for example by the BLE radio. This shows
+ * up as a bad checksum and the sample is retried. The I2S backend does not have this limitation
+ * because the samples are stored by DMA.
+ *
+ * Resources used, each of which can be changed by defining the macro when building:
+ * - DHT22GEN3_TIMER (NRF_TIMER4), shared with DHTBackendNRF52, so only use one of them
+ * - DHT22GEN3_EGU (NRF_EGU4) and DHT22GEN3_EGU_IRQn (SWI4_EGU4_IRQn)
+ * - DHT22GEN3_GPIOTE_CHANNEL (7). attachInterrupt() allocates GPIOTE channels starting from 0.
+ * - DHT22GEN3_PPI_CHANNEL (10)
+ */
+class DHTBackendNRF52Edge : public DHTBackend {
+public:
+	/**
+	 * @brief Constructor
+	 */
+	DHTBackendNRF52Edge() {};
+
+	virtual void setup();
+	virtual bool startCapture(pin_t dhtPin, const DHTCaptureConfig &config);
+	virtual bool hasTimedStart() const { return true; };
+	virtual bool startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config);
+	virtual uint32_t getLastStartPulseUs() const;
+	virtual bool isCaptureComplete();
+	virtual bool stopCapture();
+	virtual const uint16_t *getCaptureBuffer() const { return 0; };
+	virtual size_t getCaptureWords() const { return 0; };
+	virtual bool capturesEdges() const { return true; };
+	virtual const uint16_t *getEdgeBuffer() const;
+	virtual size_t getEdgeCount() const;
+	virtual void setCaptureHandler(void (*handler)(void *context), void *context);
+};
+
+/**
+ * @brief Deterministic simulated backend
+ *
+ * Simulated sensors are added with withSensor(). When a capture is started on a pin with a
+ * simulated sensor, DHTCaptureSynth generates its waveform into the capture buffer. Pins
+ * without a sensor capture a line that stays high, like a disconnected sensor.
+ *
+ * Time is simulated as well. Each call to getMillis() advances the simulated clock by the tick
+ * set with withTickUs(), so calling DHT22Gen3::loop() in a tight loop completes samples as fast
+ * as the processor can decode them, and the results are the same on every run.
+ *
+ * The capture buffer is filled in when the capture starts, but getCapturedWords() and
+ * getEdgeCount() only include the samples and edges that would have been received by the
+ * current simulated time, like the real backends.
+ *
+ * The simulated sensor only responds if the start pulse (low period) is long enough: 800
+ * microseconds for the DHT22 and 17 milliseconds for the DHT11, a little shorter than the
+ * startPulseUs of the built-in sensor types (1.1 and 18 milliseconds).
+ */
+class DHTBackendSimulated : public DHTBackend {
+public:
+	/**
+	 * @brief Maximum number of simulated sensors
+	 */
+	static const size_t MAX_SENSORS = 8;
+
+	/**
+	 * @brief Constructor
+	 */
+	DHTBackendSimulated();
+
+	/**
+	 * @brief Adds or changes a simulated sensor
+	 *
+	 * @param pin The pin the sensor is connected to
+	 *
+	 * @param tempDeciC The temperature the sensor reports in tenths of a degree C
+	 *
+	 * @param humidityDeci The humidity the sensor reports in tenths of a percent
+	 *
+	 * @param isDHT11 true for a DHT11 (whole degrees and percent, DHT11 timing), false for a DHT22
+	 */
+	DHTBackendSimulated &withSensor(pin_t pin, int tempDeciC, int humidityDeci, bool isDHT11 = false);
+
+	/**
+	 * @brief Each high and low period is changed by a random amount up to +/- jitterUs. Default is 0.
+	 */
+	DHTBackendSimulated &withJitter(uint16_t jitterUs) { synth.withJitter(jitterUs); return *this; };
+
+	/**
+	 * @brief Percentage of frames (0 - 100) that are cut off at a random bit to simulate errors. Default is 0.
+	 */
+	DHTBackendSimulated &withTruncatePercent(int truncatePercent) { this->truncatePercent = truncatePercent; return *this; };
+
+	/**
+	 * @brief Lengthens the high period of each data bit by shiftUs (negative to shorten it). Default is 0.
+	 *
+	 * The low period before the bit is changed by the opposite amount so the bit period stays the
+	 * same. Simulates a long cable, weak pull-up, or clone sensor that moves the pulse widths
+	 * toward the fixed 0/1 threshold.
+	 */
+	DHTBackendSimulated &withHighShift(int shiftUs) { this->highShiftUs = shiftUs; return *this; };
+
+	/**
+	 * @brief Amount the simulated clock advances each time it's read, in microseconds. Default is 100.
+	 */
+	DHTBackendSimulated &withTickUs(uint32_t tickUs) { this->tickUs = tickUs; return *this; };
+
+	/**
+	 * @brief Sets the seed for the pseudo-random number generator used for jitter and truncation
+	 */
+	DHTBackendSimulated &withSeed(uint32_t seed);
+
+	/**
+	 * @brief Simulate a backend that times the start pulse itself, like DHTBackendNRF52. Default is true.
+	 *
+	 * The simulated pulse ends exactly at the requested length, even if the clock is advanced past
+	 * it, like a timer interrupt.
+	 */
+	DHTBackendSimulated &withTimedStart(bool timedStart) { this->timedStart = timedStart; return *this; };
+
+	/**
+	 * @brief Simulate an edge capture backend, like DHTBackendNRF52Edge. Default is false.
+	 *
+	 * When true, the capture is a buffer of edge timestamps (getEdgeBuffer()) instead of samples.
+	 */
+	DHTBackendSimulated &withEdgeCapture(bool edgeCapture) { this->edgeCapture = edgeCapture; return *this; };
+
+	/**
+	 * @brief Advance the simulated clock
+	 *
+	 * @param us Number of microseconds to advance
+	 *
+	 * Use this to simulate time spent by the application between calls to loop(). A timed start
+	 * pulse that ends during this time ends at the correct time, like a timer interrupt. If more
+	 * of the capture is available afterwards, the handler set with setCaptureHandler() is
+	 * called, like the capture interrupt.
+	 */
+	void advance(uint32_t us);
+
+	/**
+	 * @brief Get the simulated clock in microseconds
+	 *
+	 * Unlike getMicros(), this does not advance the clock and does not roll over.
+	 */
+	uint64_t getSimulatedMicros() const { return nowUs; };
+
+	/**
+	 * @brief Returns the length of the last start pulse in simulated microseconds
+	 *
+	 * This is measured for both timed and untimed start pulses.
+	 */
+	virtual uint32_t getLastStartPulseUs() const { return lastStartPulseUs; };
+
+	virtual unsigned long getMillis();
+	virtual unsigned long getMicros();
+	virtual void setPinMode(pin_t pin, PinMode mode);
+	virtual void writePin(pin_t pin, uint8_t value);
+	virtual bool startCapture(pin_t dhtPin, const DHTCaptureConfig &config);
+	virtual bool hasTimedStart() const { return timedStart; };
+	virtual bool startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config);
+	virtual bool isCaptureComplete();
+	virtual size_t getCapturedWords();
+	virtual bool stopCapture();
+	virtual const uint16_t *getCaptureBuffer() const { return buffer; };
+	virtual size_t getCaptureWords() const { return edgeCapture ? 0 : config.numWords; };
+	virtual bool capturesEdges() const { return edgeCapture; };
+	virtual const uint16_t *getEdgeBuffer() const { return edges; };
+	virtual size_t getEdgeCount() const;
+	virtual void setCaptureHandler(void (*handler)(void *context), void *context) { captureHandler = handler; captureHandlerContext = context; };
+
+protected:
+	/**
+	 * @brief A simulated sensor
+	 */
+	class Sensor {
+	public:
+		bool inUse = false;		//!< True if this entry is used
+		pin_t pin = 0;			//!< Pin the sensor is connected to
+		bool isDHT11 = false;	//!< Sensor is a DHT11 instead of a DHT22
+		int tempDeciC = 0;		//!< Temperature in tenths of a degree C
+		int humidityDeci = 0;	//!< Humidity in tenths of a percent
+	};
+
+	/**
+	 * @brief Used internally to find the simulated sensor on a pin
+	 *
+	 * @return The sensor or 0 if there is no sensor on that pin
+	 */
+	Sensor *findSensor(pin_t pin);
+
+	/**
+	 * @brief Used internally to check that the capture fits in the buffer, like DHTBackendNRF52
+	 *
+	 * @return true if the capture can be started
+	 */
+	bool checkConfig(const DHTCaptureConfig &config) const;
+
+	/**
+	 * @brief Used internally to get the next pseudo-random number (xorshift32)
+	 */
+	uint32_t nextRandom();
+
+
+	Sensor sensors[MAX_SENSORS]; //!< Simulated sensors
+	DHTCaptureSynth synth; //!< Generates the waveforms
+	uint16_t buffer[DHT22GEN3_MAX_CAPTURE_WORDS]; //!< Capture buffer
+	uint16_t edges[DHT22GEN3_MAX_EDGES]; //!< Edge capture buffer
+	size_t numEdges = 0; //!< Number of edges in edges
+	bool edgeCapture = false; //!< Simulate an edge capture backend
+	DHTCaptureConfig config = DHTCaptureConfig::CONFIG_128K; //!< Configuration of the current or last capture
+	uint64_t nowUs = 0; //!< Simulated clock in microseconds
+	uint32_t tickUs = 100; //!< Simulated clock advances this much each time getMillis() is called
+	uint32_t seed = 1; //!< Pseudo-random generator state
+	int truncatePercent = 0; //!< Percentage of frames to truncate
+	int highShiftUs = 0; //!< Change to the high period of each data bit, see withHighShift()
+	bool capturing = false; //!< startCapture() has been called but not stopCapture()
+	uint64_t captureStartUs = 0; //!< Value of nowUs when capture started
+	uint64_t captureEndUs = 0; //!< Value of nowUs when capture was stopped
+	pin_t lowPin = PIN_INVALID; //!< Pin being driven low for the start pulse, or PIN_INVALID
+	uint64_t lowStartUs = 0; //!< Value of nowUs when lowPin went low
+	uint32_t lastStartPulseUs = 0; //!< Length of the last start pulse
+	bool timedStart = true; //!< Simulate startTimedCapture()
+	pin_t timedPin = PIN_INVALID; //!< Pin a timed start pulse is being sent on, or PIN_INVALID
+	uint64_t timedReleaseUs = 0; //!< Value of nowUs when the timed start pulse should end
+	void (*captureHandler)(void *context) = 0; //!< Called from advance() when more of the capture is available
+	void *captureHandlerContext = 0; //!< Passed to captureHandler
+	size_t notifiedCount = 0; //!< Words or edges available the last time captureHandler was called
+};
+
+#endif /* _DHTBACKEND_H */
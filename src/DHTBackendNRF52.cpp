@@ -0,0 +1,396 @@
+#include "DHTBackend.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// Must undefine this or the direct nRF52 libraries won't compile as there is a struct member SCK
+#undef SCK
+
+#include "nrf_gpio.h"
+#include "nrfx_i2s.h"
+
+// Timer used to time the start pulse. You can change it by defining both of these before
+// building the library, for example to use TIMER3 and TIMER3_IRQn.
+#ifndef DHT22GEN3_TIMER
+#define DHT22GEN3_TIMER 		NRF_TIMER4
+#define DHT22GEN3_TIMER_IRQn 	TIMER4_IRQn
+#endif
+
+// Interrupt priority for the timer interrupt
+#ifndef DHT22GEN3_TIMER_IRQ_PRIORITY
+#define DHT22GEN3_TIMER_IRQ_PRIORITY 6
+#endif
+
+// Maximum size of each piece of the capture buffer, in 16-bit words. The buffer is captured in
+// pieces so it can be decoded while the capture is in progress, and stopped as soon as the frame
+// is complete. Smaller pieces mean more interrupts, but less delay before the data can be decoded.
+// Must be even. The default of 8 is 1 ms at 128 kHz.
+#ifndef DHT22GEN3_CAPTURE_CHUNK_WORDS
+#define DHT22GEN3_CAPTURE_CHUNK_WORDS 8
+#endif
+
+// Each piece of the capture buffer is this long, if DHT22GEN3_CAPTURE_CHUNK_WORDS is large enough
+// at the sample rate. This limits the number of interrupts per sample.
+static const uint32_t CAPTURE_CHUNK_US = 1000;
+
+static volatile int buffersRequested = 0;
+// All pieces are the same size, so the last one can extend past the end of the capture
+static uint16_t sampleBuffer[DHT22GEN3_MAX_CAPTURE_WORDS + DHT22GEN3_CAPTURE_CHUNK_WORDS - 2];
+static uint16_t discardBuffer[DHT22GEN3_CAPTURE_CHUNK_WORDS];
+static volatile size_t captureWords = 0;
+static volatile size_t chunkWords = 0;
+static volatile size_t capturedWords = 0;
+static volatile bool captureFailed = false;
+static nrfx_i2s_buffers_t i2sBuffer = {
+		.p_rx_buffer = (uint32_t *)sampleBuffer,
+		.p_tx_buffer = 0
+};
+
+static volatile uint32_t timedDhtPin = 0;
+static volatile uint32_t lastStartPulseUs = 0;
+static volatile bool timedStartError = false;
+static volatile bool i2sRunning = false;
+static bool i2sInitialized = false;
+static nrf_i2s_mck_t i2sMck = NRF_I2S_MCK_DISABLED;
+static nrf_i2s_ratio_t i2sRatio = NRF_I2S_RATIO_32X;
+static void (*captureHandler)(void *context) = 0;
+static void *captureHandlerContext = 0;
+
+static void dataHandler(nrfx_i2s_buffers_t const *p_released, uint32_t status) {
+	if (status == NRFX_I2S_STATUS_NEXT_BUFFERS_NEEDED) {
+		if (!p_released) {
+			// The next buffer was not set in time and the driver is writing over the previous
+			// one (buffers_reused), so the capture can't be used
+			captureFailed = true;
+			nrfx_i2s_stop();
+			if (captureHandler) {
+				captureHandler(captureHandlerContext);
+			}
+			return;
+		}
+
+		// Called when the peripheral starts writing a chunk, so the previous one is complete.
+		// The first call is when the first chunk is started.
+		buffersRequested++;
+		size_t completeWords = (size_t)(buffersRequested - 1) * chunkWords;
+		if (completeWords >= captureWords) {
+			capturedWords = captureWords;
+			nrfx_i2s_stop();
+			if (captureHandler) {
+				captureHandler(captureHandlerContext);
+			}
+			return;
+		}
+		capturedWords = completeWords;
+		if (captureHandler && completeWords) {
+			captureHandler(captureHandlerContext);
+		}
+
+		// The chunk after the one that was just started. After the last chunk, samples go to
+		// discardBuffer until the peripheral stops, instead of over the beginning of the last chunk.
+		size_t nextOffset = completeWords + chunkWords;
+		nrfx_i2s_buffers_t next = {
+				.p_rx_buffer = (uint32_t *)((nextOffset < captureWords) ? &sampleBuffer[nextOffset] : discardBuffer),
+				.p_tx_buffer = 0
+		};
+		nrfx_i2s_next_buffers_set(&next);
+	}
+	else {
+		// Called with status 0 when the STOPPED event occurs and the peripheral has been disabled
+		i2sRunning = false;
+	}
+}
+
+static uint32_t nrfPin(pin_t pin) {
+	Hal_Pin_Info *pinMap =
+#if (SYSTEM_VERSION < SYSTEM_VERSION_ALPHA(5, 0, 0, 1))
+			HAL_Pin_Map();
+#elif (SYSTEM_VERSION >= SYSTEM_VERSION_ALPHA(6, 2, 0, 0))
+			hal_pin_map();
+#else // SYSTEM_VERSION
+			Hal_Pin_Map();
+#endif // SYSTEM_VERSION
+
+	return NRF_GPIO_PIN_MAP(pinMap[pin].gpio_port, pinMap[pin].gpio_pin);
+}
+
+static void timerHandler(void) {
+	if (DHT22GEN3_TIMER->EVENTS_COMPARE[0]) {
+		DHT22GEN3_TIMER->EVENTS_COMPARE[0] = 0;
+
+		// Go into input mode; the pull-up will keep it high
+		nrf_gpio_cfg_input(timedDhtPin, NRF_GPIO_PIN_NOPULL);
+
+		// Measure the actual pulse length, including the interrupt latency
+		DHT22GEN3_TIMER->TASKS_CAPTURE[1] = 1;
+		DHT22GEN3_TIMER->TASKS_STOP = 1;
+		lastStartPulseUs = DHT22GEN3_TIMER->CC[1];
+
+		// Sample data. The / 2 factor because the parameter is the number of 32-bit words, not number of 16-bit samples!
+		i2sRunning = true;
+		nrfx_err_t err = nrfx_i2s_start(&i2sBuffer, chunkWords / 2, 0);
+		if (err != NRFX_SUCCESS) {
+			i2sRunning = false;
+			timedStartError = true;
+		}
+	}
+}
+
+static bool mapCaptureConfig(const DHTCaptureConfig &config, nrf_i2s_mck_t &mck, nrf_i2s_ratio_t &ratio) {
+	switch(config.mckDivider) {
+	case 8: mck = NRF_I2S_MCK_32MDIV8; break;
+	case 10: mck = NRF_I2S_MCK_32MDIV10; break;
+	case 11: mck = NRF_I2S_MCK_32MDIV11; break;
+	case 15: mck = NRF_I2S_MCK_32MDIV15; break;
+	case 16: mck = NRF_I2S_MCK_32MDIV16; break;
+	case 21: mck = NRF_I2S_MCK_32MDIV21; break;
+	case 23: mck = NRF_I2S_MCK_32MDIV23; break;
+	case 30: mck = NRF_I2S_MCK_32MDIV30; break;
+	case 31: mck = NRF_I2S_MCK_32MDIV31; break;
+	case 32: mck = NRF_I2S_MCK_32MDIV32; break;
+	case 42: mck = NRF_I2S_MCK_32MDIV42; break;
+	case 63: mck = NRF_I2S_MCK_32MDIV63; break;
+	case 125: mck = NRF_I2S_MCK_32MDIV125; break;
+	default:
+		Log.info("unsupported mckDivider=%u", config.mckDivider);
+		return false;
+	}
+
+	switch(config.ratio) {
+	case 32: ratio = NRF_I2S_RATIO_32X; break;
+	case 48: ratio = NRF_I2S_RATIO_48X; break;
+	case 64: ratio = NRF_I2S_RATIO_64X; break;
+	case 96: ratio = NRF_I2S_RATIO_96X; break;
+	case 128: ratio = NRF_I2S_RATIO_128X; break;
+	case 192: ratio = NRF_I2S_RATIO_192X; break;
+	case 256: ratio = NRF_I2S_RATIO_256X; break;
+	case 384: ratio = NRF_I2S_RATIO_384X; break;
+	case 512: ratio = NRF_I2S_RATIO_512X; break;
+	default:
+		Log.info("unsupported ratio=%u", config.ratio);
+		return false;
+	}
+
+	if (config.numWords > DHT22GEN3_MAX_CAPTURE_WORDS || (config.numWords % 2) != 0) {
+		Log.info("capture numWords=%u must be even and at most DHT22GEN3_MAX_CAPTURE_WORDS", config.numWords);
+		return false;
+	}
+	return true;
+}
+
+void DHTBackendNRF52::setup() {
+	attachInterruptDirect(I2S_IRQn, nrfx_i2s_irq_handler, false);
+
+	if (persistentPeripheral) {
+		pinMode(unusedPin1, OUTPUT); // SCK
+		pinMode(unusedPin2, OUTPUT); // LRCK
+
+		// SDIN is connected to the sensor pin for each sample in initI2S()
+		initI2S(PIN_INVALID, config);
+	}
+
+	if (timedStart) {
+		DHT22GEN3_TIMER->TASKS_STOP = 1;
+		DHT22GEN3_TIMER->MODE = TIMER_MODE_MODE_Timer;
+		DHT22GEN3_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+		DHT22GEN3_TIMER->PRESCALER = 4; // 16 MHz / 2^4 = 1 MHz, 1 count per microsecond
+		DHT22GEN3_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+		attachInterruptDirect(DHT22GEN3_TIMER_IRQn, timerHandler, false);
+		NVIC_SetPriority(DHT22GEN3_TIMER_IRQn, DHT22GEN3_TIMER_IRQ_PRIORITY);
+		NVIC_EnableIRQ(DHT22GEN3_TIMER_IRQn);
+	}
+}
+
+void DHTBackendNRF52::prepareCapture() {
+	if (!persistentPeripheral) {
+		pinMode(unusedPin1, OUTPUT); // SCK
+		pinMode(unusedPin2, OUTPUT); // LRCK
+	}
+}
+
+bool DHTBackendNRF52::initI2S(pin_t dhtPin, const DHTCaptureConfig &config) {
+	unsigned long start = micros();
+
+	nrf_i2s_mck_t mck;
+	nrf_i2s_ratio_t ratio;
+	if (!mapCaptureConfig(config, mck, ratio)) {
+		return false;
+	}
+	this->config = config;
+	captureWords = config.numWords;
+
+	// CAPTURE_CHUNK_US at the sample rate (16 samples per word), up to DHT22GEN3_CAPTURE_CHUNK_WORDS.
+	// The I2S peripheral transfers 32-bit words (two 16-bit words), so it's rounded up to even.
+	size_t chunk = (size_t)(((uint64_t)config.getSampleRate() * CAPTURE_CHUNK_US / 1000000 + 31) / 32) * 2;
+	if (chunk > DHT22GEN3_CAPTURE_CHUNK_WORDS) {
+		chunk = DHT22GEN3_CAPTURE_CHUNK_WORDS;
+	}
+	if (chunk > captureWords) {
+		chunk = captureWords;
+	}
+	chunkWords = chunk;
+
+	if (persistentPeripheral && i2sInitialized) {
+		if (mck != i2sMck || ratio != i2sRatio) {
+			// Sensor type with a different sample rate. Like the pins, this can only be changed
+			// while the peripheral is disabled.
+			nrf_i2s_configure(NRF_I2S, NRF_I2S_MODE_MASTER, NRF_I2S_FORMAT_I2S, NRF_I2S_ALIGN_LEFT, NRF_I2S_SWIDTH_16BIT, NRF_I2S_CHANNELS_STEREO, mck, ratio);
+			i2sMck = mck;
+			i2sRatio = ratio;
+		}
+		if (dhtPin != PIN_INVALID) {
+			// Already configured; only the SDIN pin changes. The peripheral is disabled between
+			// samples, which is required to change the pin selection.
+			uint32_t sdinPin = nrfPin(dhtPin);
+			nrf_gpio_cfg_input(sdinPin, NRF_GPIO_PIN_NOPULL);
+			nrf_i2s_pins_set(NRF_I2S, nrfPin(unusedPin1), nrfPin(unusedPin2), NRF_I2S_PIN_NOT_CONNECTED, NRF_I2S_PIN_NOT_CONNECTED, sdinPin);
+		}
+	}
+	else {
+		nrfx_i2s_config_t i2sConfig = NRFX_I2S_DEFAULT_CONFIG;
+
+		i2sConfig.sdin_pin = (dhtPin != PIN_INVALID) ? (uint8_t)nrfPin(dhtPin) : NRFX_I2S_PIN_NOT_USED;
+		i2sConfig.sck_pin = (uint8_t)nrfPin(unusedPin1);
+		i2sConfig.lrck_pin = (uint8_t)nrfPin(unusedPin2);
+		i2sConfig.mck_pin = NRFX_I2S_PIN_NOT_USED;
+		i2sConfig.sdout_pin = NRFX_I2S_PIN_NOT_USED;
+
+		i2sConfig.mode = NRF_I2S_MODE_MASTER;
+		i2sConfig.format = NRF_I2S_FORMAT_I2S;
+		i2sConfig.alignment = NRF_I2S_ALIGN_LEFT;
+		i2sConfig.sample_width = NRF_I2S_SWIDTH_16BIT;
+		i2sConfig.channels = NRF_I2S_CHANNELS_STEREO;
+		i2sConfig.mck_setup = mck;
+		i2sConfig.ratio = ratio;
+
+		// 16-bit stereo, so each LRCK period is one 32-bit word and the bit rate is
+		// 32 MHz / mckDivider / ratio * 32. For example, MDIV125 and 64X is 4,000 words
+		// per second or 128,000 bits per second.
+
+		nrfx_err_t err = nrfx_i2s_init(&i2sConfig, dataHandler);
+		if (err != NRFX_SUCCESS) {
+			Log.info("nrfx_i2s_init error=%lu", err);
+			return false;
+		}
+		i2sInitialized = true;
+		i2sMck = mck;
+		i2sRatio = ratio;
+	}
+
+	buffersRequested = 0;
+	capturedWords = 0;
+	captureFailed = false;
+	lastCaptureSetupUs = micros() - start;
+	return true;
+}
+
+void DHTBackendNRF52::uninitI2S() {
+	nrfx_i2s_uninit();
+	i2sInitialized = false;
+	i2sRunning = false;
+}
+
+bool DHTBackendNRF52::startCapture(pin_t dhtPin, const DHTCaptureConfig &config) {
+	// We let the pull-up pull the pin high again, and it should stay that way for 20-40 us then the device takes over
+	if (!initI2S(dhtPin, config)) {
+		return false;
+	}
+
+	// Sample data. The / 2 factor because the parameter is the number of 32-bit words, not number of 16-bit samples!
+	i2sRunning = true;
+	nrfx_err_t err = nrfx_i2s_start(&i2sBuffer, chunkWords / 2, 0);
+	if (err != NRFX_SUCCESS) {
+		Log.info("nrfx_i2s_start error=%lu", err);
+		uninitI2S();
+		return false;
+	}
+	return true;
+}
+
+bool DHTBackendNRF52::startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config) {
+	// Initialize I2S first. This configures the SDIN pin as an input, which would end the start
+	// pulse if done afterwards. It does not drive the pin so it stays high from the pull-up.
+	if (!initI2S(dhtPin, config)) {
+		return false;
+	}
+
+	timedDhtPin = nrfPin(dhtPin);
+	timedStartError = false;
+	lastStartPulseUs = 0;
+
+	// Start pulse. timerHandler() releases the line and starts I2S after pulseUs.
+	nrf_gpio_pin_clear(timedDhtPin);
+	nrf_gpio_cfg_output(timedDhtPin);
+
+	DHT22GEN3_TIMER->TASKS_CLEAR = 1;
+	DHT22GEN3_TIMER->EVENTS_COMPARE[0] = 0;
+	DHT22GEN3_TIMER->CC[0] = pulseUs;
+	DHT22GEN3_TIMER->TASKS_START = 1;
+
+	return true;
+}
+
+uint32_t DHTBackendNRF52::getLastStartPulseUs() const {
+	return lastStartPulseUs;
+}
+
+bool DHTBackendNRF52::isCaptureComplete() {
+	return capturedWords >= captureWords || timedStartError || captureFailed;
+}
+
+size_t DHTBackendNRF52::getCapturedWords() {
+	return capturedWords;
+}
+
+bool DHTBackendNRF52::stopCapture() {
+	if (timedStart) {
+		// Make sure the start pulse is not still in progress, for example on timeout
+		DHT22GEN3_TIMER->TASKS_STOP = 1;
+		nrf_gpio_cfg_input(timedDhtPin, NRF_GPIO_PIN_NOPULL);
+		if (timedStartError) {
+			Log.info("nrfx_i2s_start failed from timer");
+		}
+	}
+
+	if (persistentPeripheral) {
+		if (i2sRunning) {
+			// Capture timed out, or the STOPPED event after a complete capture has not been handled
+			// yet. Stop it and wait for the STOPPED event, which should take less than one I2S frame.
+			// If that fails, start over with a full initialization for the next sample.
+			nrfx_i2s_stop();
+			unsigned long start = micros();
+			while(i2sRunning && micros() - start < 1000) {
+			}
+			if (i2sRunning) {
+				uninitI2S();
+			}
+		}
+	}
+	else {
+		// uninitialize the I2S peripheral
+		uninitI2S();
+	}
+
+	if (captureFailed) {
+		Log.info("capture buffer not set in time");
+	}
+
+	// If nothing was captured, the I2S peripheral is in a weird and unknown state (not related to
+	// the sensor). Stopping after part of the buffer is normal when the frame is already complete.
+	return capturedWords > 0 && !timedStartError && !captureFailed;
+}
+
+const uint16_t *DHTBackendNRF52::getCaptureBuffer() const {
+	return sampleBuffer;
+}
+
+size_t DHTBackendNRF52::getCaptureWords() const {
+	return config.numWords;
+}
+
+void DHTBackendNRF52::setCaptureHandler(void (*handler)(void *context), void *context) {
+	captureHandler = 0;
+	captureHandlerContext = context;
+	captureHandler = handler;
+}
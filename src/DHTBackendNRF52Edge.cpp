@@ -0,0 +1,227 @@
+#include "DHTBackend.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// Must undefine this or the direct nRF52 libraries won't compile as there is a struct member SCK
+#undef SCK
+
+#include "nrf_gpio.h"
+
+// Timer used to time the start pulse and edges. Same as DHTBackendNRF52.
+#ifndef DHT22GEN3_TIMER
+#define DHT22GEN3_TIMER 		NRF_TIMER4
+#define DHT22GEN3_TIMER_IRQn 	TIMER4_IRQn
+#endif
+
+// Interrupt priority for the timer interrupt
+#ifndef DHT22GEN3_TIMER_IRQ_PRIORITY
+#define DHT22GEN3_TIMER_IRQ_PRIORITY 6
+#endif
+
+// Event generator unit used to get an interrupt for each edge. You can change it by defining both
+// of these before building the library, for example to use NRF_EGU3 and SWI3_EGU3_IRQn.
+#ifndef DHT22GEN3_EGU
+#define DHT22GEN3_EGU 			NRF_EGU4
+#define DHT22GEN3_EGU_IRQn 		SWI4_EGU4_IRQn
+#endif
+
+// Interrupt priority for the edge interrupt. This must be high (a low number) because the
+// interrupt must run before the next edge, at least 25 us later.
+#ifndef DHT22GEN3_EGU_IRQ_PRIORITY
+#define DHT22GEN3_EGU_IRQ_PRIORITY 2
+#endif
+
+// GPIOTE channel for the data line. attachInterrupt() allocates channels starting from 0.
+#ifndef DHT22GEN3_GPIOTE_CHANNEL
+#define DHT22GEN3_GPIOTE_CHANNEL 7
+#endif
+
+// PPI channel connecting the GPIOTE event to the timer capture and EGU tasks
+#ifndef DHT22GEN3_PPI_CHANNEL
+#define DHT22GEN3_PPI_CHANNEL 10
+#endif
+
+// Falling and rising edge of the response, 2 per bit, and the falling and rising edge at the end
+
+static uint16_t edgeBuffer[DHT22GEN3_MAX_EDGES];
+static volatile size_t edgeCount = 0;
+static volatile uint32_t releaseTime = 0;
+static volatile uint32_t captureUs = 0;
+static volatile uint32_t timedDhtPin = 0;
+static volatile uint32_t lastStartPulseUs = 0;
+static volatile bool captureComplete = false;
+static void (*captureHandler)(void *context) = 0;
+static void *captureHandlerContext = 0;
+
+static uint32_t nrfPin(pin_t pin) {
+	Hal_Pin_Info *pinMap =
+#if (SYSTEM_VERSION < SYSTEM_VERSION_ALPHA(5, 0, 0, 1))
+			HAL_Pin_Map();
+#elif (SYSTEM_VERSION >= SYSTEM_VERSION_ALPHA(6, 2, 0, 0))
+			hal_pin_map();
+#else // SYSTEM_VERSION
+			Hal_Pin_Map();
+#endif // SYSTEM_VERSION
+
+	return NRF_GPIO_PIN_MAP(pinMap[pin].gpio_port, pinMap[pin].gpio_pin);
+}
+
+static void startEdges() {
+	edgeCount = 0;
+
+	// Event on both edges of the data line. The GPIOTE takes over the pin as an input.
+	NRF_GPIOTE->CONFIG[DHT22GEN3_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+			((timedDhtPin << GPIOTE_CONFIG_PSEL_Pos) & (GPIOTE_CONFIG_PORT_Msk | GPIOTE_CONFIG_PSEL_Msk)) |
+			(GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+	NRF_GPIOTE->EVENTS_IN[DHT22GEN3_GPIOTE_CHANNEL] = 0;
+	DHT22GEN3_EGU->EVENTS_TRIGGERED[0] = 0;
+	NRF_PPI->CHENSET = (1 << DHT22GEN3_PPI_CHANNEL);
+
+	// End the capture after captureUs even if the frame is incomplete
+	DHT22GEN3_TIMER->EVENTS_COMPARE[3] = 0;
+	DHT22GEN3_TIMER->CC[3] = releaseTime + captureUs;
+}
+
+static void stopEdges() {
+	NRF_PPI->CHENCLR = (1 << DHT22GEN3_PPI_CHANNEL);
+	NRF_GPIOTE->CONFIG[DHT22GEN3_GPIOTE_CHANNEL] = 0;
+	DHT22GEN3_TIMER->TASKS_STOP = 1;
+}
+
+static void timerHandler(void) {
+	if (DHT22GEN3_TIMER->EVENTS_COMPARE[0]) {
+		DHT22GEN3_TIMER->EVENTS_COMPARE[0] = 0;
+
+		// Go into input mode; the pull-up will keep it high
+		nrf_gpio_cfg_input(timedDhtPin, NRF_GPIO_PIN_NOPULL);
+
+		// Edge times are relative to when the line was released. The timer keeps running.
+		DHT22GEN3_TIMER->TASKS_CAPTURE[1] = 1;
+		releaseTime = DHT22GEN3_TIMER->CC[1];
+		lastStartPulseUs = releaseTime;
+
+		startEdges();
+	}
+	if (DHT22GEN3_TIMER->EVENTS_COMPARE[3]) {
+		DHT22GEN3_TIMER->EVENTS_COMPARE[3] = 0;
+
+		// Timeout, the sensor did not send a complete frame
+		stopEdges();
+		captureComplete = true;
+		if (captureHandler) {
+			captureHandler(captureHandlerContext);
+		}
+	}
+}
+
+static void eguHandler(void) {
+	if (DHT22GEN3_EGU->EVENTS_TRIGGERED[0]) {
+		DHT22GEN3_EGU->EVENTS_TRIGGERED[0] = 0;
+
+		// The PPI channel captured the timer into CC[2] at the edge
+		if (edgeCount < DHT22GEN3_MAX_EDGES) {
+			edgeBuffer[edgeCount++] = (uint16_t)(DHT22GEN3_TIMER->CC[2] - releaseTime);
+		}
+		if (edgeCount >= DHTBackend::EDGES_PER_FRAME) {
+			stopEdges();
+			captureComplete = true;
+			if (captureHandler) {
+				captureHandler(captureHandlerContext);
+			}
+		}
+	}
+}
+
+void DHTBackendNRF52Edge::setup() {
+	DHT22GEN3_TIMER->TASKS_STOP = 1;
+	DHT22GEN3_TIMER->MODE = TIMER_MODE_MODE_Timer;
+	DHT22GEN3_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+	DHT22GEN3_TIMER->PRESCALER = 4; // 16 MHz / 2^4 = 1 MHz, 1 count per microsecond
+	DHT22GEN3_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk | TIMER_INTENSET_COMPARE3_Msk;
+
+	attachInterruptDirect(DHT22GEN3_TIMER_IRQn, timerHandler, false);
+	NVIC_SetPriority(DHT22GEN3_TIMER_IRQn, DHT22GEN3_TIMER_IRQ_PRIORITY);
+	NVIC_EnableIRQ(DHT22GEN3_TIMER_IRQn);
+
+	// Each edge: GPIOTE IN event -> timer capture CC[2], and fork -> EGU interrupt to store it
+	NRF_PPI->CH[DHT22GEN3_PPI_CHANNEL].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[DHT22GEN3_GPIOTE_CHANNEL];
+	NRF_PPI->CH[DHT22GEN3_PPI_CHANNEL].TEP = (uint32_t)&DHT22GEN3_TIMER->TASKS_CAPTURE[2];
+	NRF_PPI->FORK[DHT22GEN3_PPI_CHANNEL].TEP = (uint32_t)&DHT22GEN3_EGU->TASKS_TRIGGER[0];
+
+	DHT22GEN3_EGU->INTENSET = EGU_INTENSET_TRIGGERED0_Msk;
+	attachInterruptDirect(DHT22GEN3_EGU_IRQn, eguHandler, false);
+	NVIC_SetPriority(DHT22GEN3_EGU_IRQn, DHT22GEN3_EGU_IRQ_PRIORITY);
+	NVIC_EnableIRQ(DHT22GEN3_EGU_IRQn);
+}
+
+bool DHTBackendNRF52Edge::startCapture(pin_t dhtPin, const DHTCaptureConfig &config) {
+	// The line has already been released; start timing edges from now
+	timedDhtPin = nrfPin(dhtPin);
+	captureUs = (uint32_t)((uint64_t)config.numWords * 16 * 1000000 / config.getSampleRate());
+	captureComplete = false;
+	edgeCount = 0;
+	releaseTime = 0;
+
+	DHT22GEN3_TIMER->TASKS_CLEAR = 1;
+	DHT22GEN3_TIMER->EVENTS_COMPARE[0] = 0;
+	DHT22GEN3_TIMER->CC[0] = 0xffffffff;
+	startEdges();
+	DHT22GEN3_TIMER->TASKS_START = 1;
+
+	return true;
+}
+
+bool DHTBackendNRF52Edge::startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config) {
+	timedDhtPin = nrfPin(dhtPin);
+
+	// Only the length of the capture is used from the config, not the sample rate
+	captureUs = (uint32_t)((uint64_t)config.numWords * 16 * 1000000 / config.getSampleRate());
+	captureComplete = false;
+	edgeCount = 0;
+	lastStartPulseUs = 0;
+
+	// Start pulse. timerHandler() releases the line and starts capturing edges after pulseUs.
+	nrf_gpio_pin_clear(timedDhtPin);
+	nrf_gpio_cfg_output(timedDhtPin);
+
+	DHT22GEN3_TIMER->TASKS_CLEAR = 1;
+	DHT22GEN3_TIMER->EVENTS_COMPARE[0] = 0;
+	DHT22GEN3_TIMER->EVENTS_COMPARE[3] = 0;
+	DHT22GEN3_TIMER->CC[0] = pulseUs;
+	DHT22GEN3_TIMER->CC[3] = 0xffffffff;
+	DHT22GEN3_TIMER->TASKS_START = 1;
+
+	return true;
+}
+
+uint32_t DHTBackendNRF52Edge::getLastStartPulseUs() const {
+	return lastStartPulseUs;
+}
+
+bool DHTBackendNRF52Edge::isCaptureComplete() {
+	return captureComplete;
+}
+
+bool DHTBackendNRF52Edge::stopCapture() {
+	// Make sure the start pulse and capture are not still in progress, for example on timeout
+	stopEdges();
+	nrf_gpio_cfg_input(timedDhtPin, NRF_GPIO_PIN_NOPULL);
+
+	// DHT22Gen3 stops the capture as soon as all 40 bits are decoded, which is before the last edge
+	return captureComplete || edgeCount >= EDGES_PER_FRAME - 1;
+}
+
+const uint16_t *DHTBackendNRF52Edge::getEdgeBuffer() const {
+	return edgeBuffer;
+}
+
+size_t DHTBackendNRF52Edge::getEdgeCount() const {
+	return edgeCount;
+}
+
+void DHTBackendNRF52Edge::setCaptureHandler(void (*handler)(void *context), void *context) {
+	captureHandler = 0;
+	captureHandlerContext = context;
+	captureHandler = handler;
+}
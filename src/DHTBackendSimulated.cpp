@@ -0,0 +1,221 @@
+#include "DHTBackend.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+DHTBackendSimulated::DHTBackendSimulated() {
+	memset(buffer, 0xff, sizeof(buffer));
+}
+
+DHTBackendSimulated &DHTBackendSimulated::withSensor(pin_t pin, int tempDeciC, int humidityDeci, bool isDHT11) {
+	Sensor *sensor = findSensor(pin);
+	if (!sensor) {
+		for(size_t ii = 0; ii < MAX_SENSORS; ii++) {
+			if (!sensors[ii].inUse) {
+				sensor = &sensors[ii];
+				break;
+			}
+		}
+		if (!sensor) {
+			Log.info("too many simulated sensors");
+			return *this;
+		}
+	}
+	sensor->inUse = true;
+	sensor->pin = pin;
+	sensor->isDHT11 = isDHT11;
+	sensor->tempDeciC = tempDeciC;
+	sensor->humidityDeci = humidityDeci;
+	return *this;
+}
+
+DHTBackendSimulated &DHTBackendSimulated::withSeed(uint32_t seed) {
+	this->seed = seed ? seed : 1;
+	synth.withSeed(seed);
+	return *this;
+}
+
+void DHTBackendSimulated::advance(uint32_t us) {
+	uint64_t targetUs = nowUs + us;
+
+	if (timedPin != PIN_INVALID && targetUs >= timedReleaseUs) {
+		// End of a timed start pulse, like the timer interrupt on real hardware
+		pin_t pin = timedPin;
+		timedPin = PIN_INVALID;
+		nowUs = timedReleaseUs;
+		setPinMode(pin, INPUT);
+		startCapture(pin, config);
+	}
+	nowUs = targetUs;
+
+	if (capturing && captureHandler) {
+		size_t count = edgeCapture ? getEdgeCount() : getCapturedWords();
+		if (count > notifiedCount) {
+			// More of the capture is available, like the capture interrupt on real hardware
+			notifiedCount = count;
+			captureHandler(captureHandlerContext);
+		}
+	}
+}
+
+unsigned long DHTBackendSimulated::getMillis() {
+	advance(tickUs);
+	return (unsigned long)(nowUs / 1000);
+}
+
+unsigned long DHTBackendSimulated::getMicros() {
+	advance(tickUs);
+	return (unsigned long)nowUs;
+}
+
+void DHTBackendSimulated::setPinMode(pin_t pin, PinMode mode) {
+	if (pin == lowPin && mode != OUTPUT) {
+		// Released the line, ending the start pulse
+		lastStartPulseUs = (uint32_t)(nowUs - lowStartUs);
+		lowPin = PIN_INVALID;
+	}
+}
+
+void DHTBackendSimulated::writePin(pin_t pin, uint8_t value) {
+	if (value == LOW) {
+		lowPin = pin;
+		lowStartUs = nowUs;
+	}
+	else
+	if (pin == lowPin) {
+		lastStartPulseUs = (uint32_t)(nowUs - lowStartUs);
+		lowPin = PIN_INVALID;
+	}
+}
+
+bool DHTBackendSimulated::startCapture(pin_t dhtPin, const DHTCaptureConfig &config) {
+	Sensor *sensor = findSensor(dhtPin);
+
+	if (!checkConfig(config)) {
+		return false;
+	}
+	this->config = config;
+	synth.withSampleRate(config.getSampleRate());
+
+	if (sensor && lastStartPulseUs >= (sensor->isDHT11 ? 17000 : 800)) {
+		uint8_t bytes[5];
+		DHTCaptureSynth::Timing timing;
+		if (sensor->isDHT11) {
+			DHTCaptureSynth::makeBytesDHT11(sensor->tempDeciC / 10, sensor->humidityDeci / 10, bytes);
+			timing = DHTCaptureSynth::TIMING_DHT11;
+		}
+		else {
+			DHTCaptureSynth::makeBytesDHT22(sensor->tempDeciC, sensor->humidityDeci, bytes);
+			timing = DHTCaptureSynth::TIMING_DHT22;
+		}
+		if (highShiftUs) {
+			timing.bitLowUs = (uint16_t)(timing.bitLowUs - highShiftUs);
+			timing.zeroHighUs = (uint16_t)(timing.zeroHighUs + highShiftUs);
+			timing.oneHighUs = (uint16_t)(timing.oneHighUs + highShiftUs);
+		}
+		synth.withTiming(timing);
+
+		if (truncatePercent > 0 && (int)(nextRandom() % 100) < truncatePercent) {
+			synth.withNumBits((int)(nextRandom() % 40));
+		}
+		else {
+			synth.withNumBits(40);
+		}
+		if (edgeCapture) {
+			numEdges = synth.generateEdges(bytes, edges, DHT22GEN3_MAX_EDGES);
+		}
+		else {
+			synth.generate(bytes, buffer, this->config.numWords);
+		}
+	}
+	else {
+		// No sensor, or the sensor did not see the start pulse, so the pull-up keeps the line high
+		memset(buffer, 0xff, sizeof(buffer));
+		numEdges = 0;
+	}
+
+	captureStartUs = nowUs;
+	notifiedCount = 0;
+	capturing = true;
+	return true;
+}
+
+bool DHTBackendSimulated::startTimedCapture(pin_t dhtPin, uint32_t pulseUs, const DHTCaptureConfig &config) {
+	if (!checkConfig(config)) {
+		return false;
+	}
+	this->config = config;
+	writePin(dhtPin, LOW);
+	timedPin = dhtPin;
+	timedReleaseUs = nowUs + pulseUs;
+
+	// Nothing has been captured until the line is released
+	captureStartUs = captureEndUs = nowUs;
+	return true;
+}
+
+bool DHTBackendSimulated::isCaptureComplete() {
+	return capturing && (nowUs - captureStartUs) >= (uint64_t)config.numWords * 16 * 1000000 / config.getSampleRate();
+}
+
+size_t DHTBackendSimulated::getCapturedWords() {
+	if (edgeCapture) {
+		return 0;
+	}
+	uint64_t elapsedUs = (capturing ? nowUs : captureEndUs) - captureStartUs;
+	uint64_t words = elapsedUs * config.getSampleRate() / 1000000 / 16;
+	return (words < config.numWords) ? (size_t)words : config.numWords;
+}
+
+size_t DHTBackendSimulated::getEdgeCount() const {
+	uint64_t elapsedUs = (capturing ? nowUs : captureEndUs) - captureStartUs;
+
+	size_t count = 0;
+	while(count < numEdges && edges[count] <= elapsedUs) {
+		count++;
+	}
+	return count;
+}
+
+bool DHTBackendSimulated::stopCapture() {
+	// Same result as the real backends: DHTBackendNRF52 succeeds if anything was captured, and
+	// DHTBackendNRF52Edge if the capture completed (all edges or timeout) or the frame was decoded
+	bool success = false;
+	if (capturing) {
+		if (edgeCapture) {
+			success = isCaptureComplete() || getEdgeCount() >= EDGES_PER_FRAME - 1;
+		}
+		else {
+			success = getCapturedWords() > 0;
+		}
+	}
+	capturing = false;
+	captureEndUs = nowUs;
+	timedPin = PIN_INVALID;
+	return success;
+}
+
+bool DHTBackendSimulated::checkConfig(const DHTCaptureConfig &config) const {
+	// Same limits as DHTBackendNRF52, which can't start the capture. Edge capture doesn't use the buffer.
+	if (!edgeCapture && (config.numWords > DHT22GEN3_MAX_CAPTURE_WORDS || (config.numWords % 2) != 0)) {
+		Log.info("capture numWords=%u must be even and at most DHT22GEN3_MAX_CAPTURE_WORDS", config.numWords);
+		return false;
+	}
+	return true;
+}
+
+DHTBackendSimulated::Sensor *DHTBackendSimulated::findSensor(pin_t pin) {
+	for(size_t ii = 0; ii < MAX_SENSORS; ii++) {
+		if (sensors[ii].inUse && sensors[ii].pin == pin) {
+			return &sensors[ii];
+		}
+	}
+	return 0;
+}
+
+uint32_t DHTBackendSimulated::nextRandom() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
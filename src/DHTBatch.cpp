@@ -0,0 +1,157 @@
+#include "DHTBatch.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+#include <string.h>
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+//
+// Encoder
+//
+DHTBatchEncoder::DHTBatchEncoder(uint8_t *buf, size_t bufSize) : buf(buf), bufSize(bufSize) {
+	reset();
+}
+
+void DHTBatchEncoder::reset() {
+	size = 0;
+	count = 0;
+	lastTimeSec = 0;
+	lastTempDeciC = 0;
+	lastHumidityDeci = 0;
+	if (bufSize > 0) {
+		buf[size++] = FORMAT_VERSION;
+	}
+}
+
+bool DHTBatchEncoder::add(uint32_t timeSec, int16_t tempDeciC, int16_t humidityDeci) {
+	if (size == 0 || (count > 0 && timeSec < lastTimeSec)) {
+		return false;
+	}
+
+	// Encode into a temporary buffer first so nothing is changed if it doesn't fit
+	uint8_t temp[MAX_SAMPLE_SIZE];
+	size_t len = putVarint(timeSec - lastTimeSec, temp);
+	len += putSignedVarint((int32_t)tempDeciC - lastTempDeciC, &temp[len]);
+	len += putSignedVarint((int32_t)humidityDeci - lastHumidityDeci, &temp[len]);
+
+	if (size + len > bufSize) {
+		return false;
+	}
+	memcpy(&buf[size], temp, len);
+	size += len;
+	count++;
+
+	lastTimeSec = timeSec;
+	lastTempDeciC = tempDeciC;
+	lastHumidityDeci = humidityDeci;
+	return true;
+}
+
+// [static]
+size_t DHTBatchEncoder::putVarint(uint32_t value, uint8_t *dst) {
+	size_t len = 0;
+	while(value >= 0x80) {
+		dst[len++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	dst[len++] = (uint8_t)value;
+	return len;
+}
+
+// [static]
+size_t DHTBatchEncoder::base64Encode(const uint8_t *src, size_t srcLen, char *dst, size_t dstSize) {
+	size_t textLen = (srcLen + 2) / 3 * 4;
+	if (textLen + 1 > dstSize) {
+		return 0;
+	}
+
+	char *out = dst;
+	for(size_t ii = 0; ii < srcLen; ii += 3) {
+		uint32_t value = (uint32_t)src[ii] << 16;
+		if (ii + 1 < srcLen) {
+			value |= (uint32_t)src[ii + 1] << 8;
+		}
+		if (ii + 2 < srcLen) {
+			value |= src[ii + 2];
+		}
+		*out++ = base64Chars[(value >> 18) & 0x3f];
+		*out++ = base64Chars[(value >> 12) & 0x3f];
+		*out++ = (ii + 1 < srcLen) ? base64Chars[(value >> 6) & 0x3f] : '=';
+		*out++ = (ii + 2 < srcLen) ? base64Chars[value & 0x3f] : '=';
+	}
+	*out = 0;
+
+	return textLen;
+}
+
+//
+// Decoder
+//
+DHTBatchDecoder::DHTBatchDecoder(const uint8_t *data, size_t dataLen) : data(data), dataLen(dataLen) {
+	if (dataLen < 1 || data[0] != DHTBatchEncoder::FORMAT_VERSION) {
+		error = true;
+	}
+	offset = 1;
+}
+
+bool DHTBatchDecoder::next(uint32_t &timeSec, int16_t &tempDeciC, int16_t &humidityDeci) {
+	if (error || offset >= dataLen) {
+		return false;
+	}
+
+	uint32_t timeDelta, tempZigzag, humidityZigzag;
+	if (!getVarint(timeDelta) || !getVarint(tempZigzag) || !getVarint(humidityZigzag)) {
+		error = true;
+		return false;
+	}
+
+	lastTimeSec += timeDelta;
+	lastTempDeciC = (int16_t)(lastTempDeciC + (int32_t)((tempZigzag >> 1) ^ -(tempZigzag & 1)));
+	lastHumidityDeci = (int16_t)(lastHumidityDeci + (int32_t)((humidityZigzag >> 1) ^ -(humidityZigzag & 1)));
+
+	timeSec = lastTimeSec;
+	tempDeciC = lastTempDeciC;
+	humidityDeci = lastHumidityDeci;
+	return true;
+}
+
+bool DHTBatchDecoder::getVarint(uint32_t &value) {
+	value = 0;
+	for(int shift = 0; shift < 35; shift += 7) {
+		if (offset >= dataLen) {
+			return false;
+		}
+		uint8_t b = data[offset++];
+		value |= (uint32_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// [static]
+size_t DHTBatchDecoder::base64Decode(const char *src, uint8_t *dst, size_t dstSize) {
+	uint32_t value = 0;
+	int bits = 0;
+	size_t len = 0;
+
+	for(; *src && *src != '='; src++) {
+		const char *found = strchr(base64Chars, *src);
+		if (!found) {
+			return 0;
+		}
+		value = (value << 6) | (uint32_t)(found - base64Chars);
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			if (len >= dstSize) {
+				return 0;
+			}
+			dst[len++] = (uint8_t)(value >> bits);
+		}
+	}
+	return len;
+}
@@ -0,0 +1,220 @@
+#ifndef _DHTBATCH_H
+#define _DHTBATCH_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// This file does not depend on Particle.h so it can also be built and tested on a host computer.
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Encodes a sequence of samples into a compact binary format for publishing
+ *
+ * Format (version 1):
+ *
+ * - 1 byte: format version (FORMAT_VERSION)
+ * - For each sample, three values, each the difference from the previous sample (or from 0 for
+ *   the first sample):
+ *   - time in seconds, as an unsigned varint (LEB128, 7 bits per byte, least significant first)
+ *   - temperature in tenths of a degree C, as a zigzag-encoded signed varint
+ *   - humidity in tenths of a percent, as a zigzag-encoded signed varint
+ *
+ * Samples must be added oldest first. The first sample has the full time, for example a Unix
+ * time, and each later one the number of seconds since the previous one. With a sample every 30
+ * seconds and the usual small changes in temperature and humidity, each sample after the first
+ * is 3 bytes. There is no count; the decoder reads until the end of the data.
+ *
+ * Use encodeBase64() to convert the result to text for Particle.publish(). DHTBatchDecoder
+ * decodes it, and can be built on a host computer.
+ */
+class DHTBatchEncoder {
+public:
+	/**
+	 * @brief Version number stored in the first byte
+	 */
+	static const uint8_t FORMAT_VERSION = 1;
+
+	/**
+	 * @brief Maximum number of bytes one sample can use
+	 */
+	static const size_t MAX_SAMPLE_SIZE = 5 + 3 + 3;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param buf Buffer to store the binary data in. Must remain valid while encoding.
+	 *
+	 * @param bufSize Size of buf in bytes. To fit a text size after base64 encoding, use
+	 * getMaxBinarySize().
+	 */
+	DHTBatchEncoder(uint8_t *buf, size_t bufSize);
+
+	/**
+	 * @brief Discards the encoded samples and starts over
+	 */
+	void reset();
+
+	/**
+	 * @brief Adds a sample
+	 *
+	 * @param timeSec Time of the sample in seconds, for example a Unix time. Must not be less than
+	 * the time of the previous sample.
+	 *
+	 * @param tempDeciC Temperature in tenths of a degree C (DHTSample::getTempDeciC())
+	 *
+	 * @param humidityDeci Humidity in tenths of a percent (DHTSample::getHumidityDeci())
+	 *
+	 * @return true if added, or false if the sample does not fit in the buffer or the time went
+	 * backwards. If false, the data encoded so far is unchanged.
+	 */
+	bool add(uint32_t timeSec, int16_t tempDeciC, int16_t humidityDeci);
+
+	/**
+	 * @brief Returns the binary data
+	 */
+	const uint8_t *getBuffer() const { return buf; };
+
+	/**
+	 * @brief Returns the number of bytes of binary data
+	 */
+	size_t getSize() const { return size; };
+
+	/**
+	 * @brief Returns the number of samples added
+	 */
+	size_t getCount() const { return count; };
+
+	/**
+	 * @brief Converts the binary data to base64 text
+	 *
+	 * @param dst Buffer for the text. It will be null terminated.
+	 *
+	 * @param dstSize Size of dst in bytes, including the null terminator
+	 *
+	 * @return The length of the text, not including the null terminator, or 0 if it does not fit
+	 */
+	size_t encodeBase64(char *dst, size_t dstSize) const { return base64Encode(buf, size, dst, dstSize); };
+
+	/**
+	 * @brief Returns the largest binary size that fits in a text buffer after base64 encoding
+	 *
+	 * @param textSize Size of the text buffer, including the null terminator
+	 */
+	static constexpr size_t getMaxBinarySize(size_t textSize) { return (textSize > 0) ? (textSize - 1) / 4 * 3 : 0; };
+
+	/**
+	 * @brief Base64 encode data (RFC 4648, with padding)
+	 *
+	 * @param src Data to encode
+	 *
+	 * @param srcLen Number of bytes in src
+	 *
+	 * @param dst Buffer for the text. It will be null terminated.
+	 *
+	 * @param dstSize Size of dst in bytes, including the null terminator
+	 *
+	 * @return The length of the text, not including the null terminator, or 0 if it does not fit
+	 */
+	static size_t base64Encode(const uint8_t *src, size_t srcLen, char *dst, size_t dstSize);
+
+protected:
+	/**
+	 * @brief Used internally to store an unsigned varint
+	 *
+	 * @return The number of bytes stored in dst (1 to 5)
+	 */
+	static size_t putVarint(uint32_t value, uint8_t *dst);
+
+	/**
+	 * @brief Used internally to store a zigzag-encoded signed varint
+	 */
+	static size_t putSignedVarint(int32_t value, uint8_t *dst) { return putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31), dst); };
+
+	uint8_t *buf;				//!< Buffer for the binary data
+	size_t bufSize;				//!< Size of buf
+	size_t size = 0;			//!< Number of bytes in buf
+	size_t count = 0;			//!< Number of samples added
+	uint32_t lastTimeSec = 0;	//!< Time of the previous sample
+	int16_t lastTempDeciC = 0;	//!< Temperature of the previous sample
+	int16_t lastHumidityDeci = 0; //!< Humidity of the previous sample
+};
+
+/**
+ * @brief Decodes data created by DHTBatchEncoder
+ *
+ * ```
+ * uint8_t data[512];
+ * size_t dataLen = DHTBatchDecoder::base64Decode(text, data, sizeof(data));
+ *
+ * DHTBatchDecoder decoder(data, dataLen);
+ * uint32_t timeSec;
+ * int16_t tempDeciC, humidityDeci;
+ * while(decoder.next(timeSec, tempDeciC, humidityDeci)) {
+ *     // Use the sample
+ * }
+ * if (decoder.isError()) {
+ *     // Data was corrupted or is an unsupported version
+ * }
+ * ```
+ */
+class DHTBatchDecoder {
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param data Binary data from DHTBatchEncoder::getBuffer() or base64Decode()
+	 *
+	 * @param dataLen Number of bytes of data
+	 */
+	DHTBatchDecoder(const uint8_t *data, size_t dataLen);
+
+	/**
+	 * @brief Gets the next sample
+	 *
+	 * @param timeSec Filled in with the time of the sample in seconds
+	 *
+	 * @param tempDeciC Filled in with the temperature in tenths of a degree C
+	 *
+	 * @param humidityDeci Filled in with the humidity in tenths of a percent
+	 *
+	 * @return true if a sample was decoded, false at the end of the data or on error
+	 */
+	bool next(uint32_t &timeSec, int16_t &tempDeciC, int16_t &humidityDeci);
+
+	/**
+	 * @brief Returns true if the data ended in the middle of a sample or has an unsupported version
+	 */
+	bool isError() const { return error; };
+
+	/**
+	 * @brief Base64 decode text (RFC 4648, padding optional)
+	 *
+	 * @param src Null terminated text to decode
+	 *
+	 * @param dst Buffer for the decoded data
+	 *
+	 * @param dstSize Size of dst in bytes
+	 *
+	 * @return The number of bytes stored in dst, or 0 if the text is invalid or does not fit
+	 */
+	static size_t base64Decode(const char *src, uint8_t *dst, size_t dstSize);
+
+protected:
+	/**
+	 * @brief Used internally to read an unsigned varint
+	 *
+	 * @return false if the data ended or the varint is too long
+	 */
+	bool getVarint(uint32_t &value);
+
+	const uint8_t *data;		//!< Data to decode
+	size_t dataLen;				//!< Number of bytes in data
+	size_t offset = 0;			//!< Offset of the next byte to read from data
+	bool error = false;			//!< Data is corrupted or an unsupported version
+	uint32_t lastTimeSec = 0;	//!< Time of the previous sample
+	int16_t lastTempDeciC = 0;	//!< Temperature of the previous sample
+	int16_t lastHumidityDeci = 0; //!< Humidity of the previous sample
+};
+
+#endif /* _DHTBATCH_H */
@@ -0,0 +1,116 @@
+#include "DHTCaptureSynth.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+#include <string.h>
+
+// releaseUs, responseLowUs, responseHighUs, bitLowUs, zeroHighUs, oneHighUs
+const DHTCaptureSynth::Timing DHTCaptureSynth::TIMING_DHT22 = { 30, 80, 80, 50, 27, 70 };
+const DHTCaptureSynth::Timing DHTCaptureSynth::TIMING_DHT11 = { 30, 83, 87, 54, 24, 71 };
+
+DHTCaptureSynth::DHTCaptureSynth() : timing(TIMING_DHT22) {
+}
+
+void DHTCaptureSynth::generate(const uint8_t *bytes, uint16_t *words, size_t numWords) {
+	// Line is high (pulled up) unless the sensor is pulling it low, so start with all 1s
+	// and clear the bits for the low periods.
+	memset(words, 0xff, numWords * sizeof(uint16_t));
+
+	edgesUs = 0;
+	generateFrame(bytes, words, numWords);
+}
+
+size_t DHTCaptureSynth::generateEdges(const uint8_t *bytes, uint16_t *edgesUs, size_t maxEdges) {
+	this->edgesUs = edgesUs;
+	this->maxEdges = maxEdges;
+	numEdges = 0;
+
+	generateFrame(bytes, 0, 0);
+
+	// Rising edge when the sensor releases the line at the end of the frame
+	addEdge();
+
+	this->edgesUs = 0;
+	return numEdges;
+}
+
+void DHTCaptureSynth::generateFrame(const uint8_t *bytes, uint16_t *words, size_t numWords) {
+	timeNs = 0;
+
+	addPeriod(true, timing.releaseUs, words, numWords);
+	addPeriod(false, timing.responseLowUs, words, numWords);
+	addPeriod(true, timing.responseHighUs, words, numWords);
+
+	for(int ii = 0; ii < numBits && ii < 40; ii++) {
+		bool bit = (bytes[ii / 8] & (1 << (7 - (ii % 8)))) != 0;
+
+		addPeriod(false, timing.bitLowUs, words, numWords);
+		addPeriod(true, bit ? timing.oneHighUs : timing.zeroHighUs, words, numWords);
+	}
+
+	// The sensor pulls the line low for one more bit low period then releases it
+	addPeriod(false, timing.bitLowUs, words, numWords);
+}
+
+// [static]
+void DHTCaptureSynth::makeBytesDHT22(int tempDeciC, int humidityDeci, uint8_t *bytes) {
+	uint16_t temp = (tempDeciC < 0) ? (0x8000 | (uint16_t)-tempDeciC) : (uint16_t)tempDeciC;
+
+	bytes[0] = (uint8_t)(humidityDeci >> 8);
+	bytes[1] = (uint8_t)humidityDeci;
+	bytes[2] = (uint8_t)(temp >> 8);
+	bytes[3] = (uint8_t)temp;
+	bytes[4] = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+}
+
+// [static]
+void DHTCaptureSynth::makeBytesDHT11(int tempC, int humidity, uint8_t *bytes) {
+	bytes[0] = (uint8_t)humidity;
+	bytes[1] = 0;
+	bytes[2] = (uint8_t)tempC;
+	bytes[3] = 0;
+	bytes[4] = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+}
+
+void DHTCaptureSynth::addPeriod(bool level, uint32_t nominalUs, uint16_t *words, size_t numWords) {
+	int32_t periodNs = (int32_t)nominalUs * 1000;
+	if (jitterUs) {
+		int32_t range = (int32_t)jitterUs * 2000 + 1;
+		periodNs += (int32_t)(nextRandom() % range) - (int32_t)jitterUs * 1000;
+		if (periodNs < 1000) {
+			periodNs = 1000;
+		}
+	}
+
+	uint64_t startNs = timeNs;
+	if (startNs != 0) {
+		// Every period except the first one (line released, before the sensor responds) starts with an edge
+		addEdge();
+	}
+	timeNs += periodNs;
+
+	if (!level) {
+		// Sample n is taken at n / sampleRate seconds
+		size_t numSamples = numWords * 16;
+		size_t first = (size_t)((startNs * sampleRate + 999999999) / 1000000000);
+		size_t last = (size_t)((timeNs * sampleRate + 999999999) / 1000000000);
+		for(size_t ii = first; ii < last && ii < numSamples; ii++) {
+			words[ii / 16] &= ~(1 << (15 - (ii % 16)));
+		}
+	}
+}
+
+void DHTCaptureSynth::addEdge() {
+	if (edgesUs && numEdges < maxEdges) {
+		// The timer used by DHTBackendNRF52Edge counts whole microseconds
+		edgesUs[numEdges++] = (uint16_t)(timeNs / 1000);
+	}
+}
+
+uint32_t DHTCaptureSynth::nextRandom() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
@@ -0,0 +1,164 @@
+#ifndef _DHTCAPTURESYNTH_H
+#define _DHTCAPTURESYNTH_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// This file does not depend on Particle.h so it can also be built and tested on a host computer.
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Generates synthetic captures of the DHT11/DHT22 data line
+ *
+ * The output is in the same format as the I2S capture buffer used by DHT22Gen3: 16-bit words,
+ * most significant bit first, one bit per sample. It's used to benchmark and test DHTDecoder
+ * without hardware, and by the simulated backend.
+ *
+ * The capture starts when the host releases the data line after the start pulse.
+ */
+class DHTCaptureSynth {
+public:
+	/**
+	 * @brief Timing of the waveform sent by the sensor, in microseconds
+	 */
+	class Timing {
+	public:
+		uint16_t releaseUs;			//!< Time from releasing the line until the sensor pulls it low (20-40 us)
+		uint16_t responseLowUs;		//!< Length of the low part of the start sequence (80 us)
+		uint16_t responseHighUs;	//!< Length of the high part of the start sequence (80 us)
+		uint16_t bitLowUs;			//!< Low period before each data bit (50 us)
+		uint16_t zeroHighUs;		//!< High period for a 0 bit (26-28 us)
+		uint16_t oneHighUs;			//!< High period for a 1 bit (70 us)
+	};
+
+	/**
+	 * @brief Nominal DHT22 (AM2302) timing from the datasheet
+	 */
+	static const Timing TIMING_DHT22;
+
+	/**
+	 * @brief Nominal DHT11 timing from the datasheet
+	 */
+	static const Timing TIMING_DHT11;
+
+	/**
+	 * @brief I2S sample rate of the built-in sensor types (32 MHz / 125 with a ratio of 64), 128 kHz.
+	 * This is DHTCaptureConfig::CONFIG_128K.
+	 */
+	static const uint32_t DEFAULT_SAMPLE_RATE = 128000;
+
+	/**
+	 * @brief Constructor. Uses TIMING_DHT22 and DEFAULT_SAMPLE_RATE without jitter.
+	 */
+	DHTCaptureSynth();
+
+	/**
+	 * @brief Sets the waveform timing. Default is TIMING_DHT22.
+	 */
+	DHTCaptureSynth &withTiming(const Timing &timing) { this->timing = timing; return *this; };
+
+	/**
+	 * @brief Sets the sample rate of the capture in samples (bits) per second
+	 */
+	DHTCaptureSynth &withSampleRate(uint32_t sampleRate) { this->sampleRate = sampleRate; return *this; };
+
+	/**
+	 * @brief Each high and low period is changed by a random amount up to +/- jitterUs
+	 */
+	DHTCaptureSynth &withJitter(uint16_t jitterUs) { this->jitterUs = jitterUs; return *this; };
+
+	/**
+	 * @brief Stop the frame after this many data bits (0 - 40) to simulate a truncated frame.
+	 * Default is 40 (complete frame).
+	 */
+	DHTCaptureSynth &withNumBits(int numBits) { this->numBits = numBits; return *this; };
+
+	/**
+	 * @brief Sets the seed for the pseudo-random number generator used for jitter
+	 *
+	 * The generator is deterministic so the same seed produces the same captures.
+	 */
+	DHTCaptureSynth &withSeed(uint32_t seed) { this->seed = seed ? seed : 1; return *this; };
+
+	/**
+	 * @brief Generate a capture
+	 *
+	 * @param bytes The 5 bytes to send (4 data bytes and the checksum)
+	 *
+	 * @param words Buffer to fill in
+	 *
+	 * @param numWords Number of 16-bit words in words. The whole buffer is filled in; after the
+	 * end of the frame the line is high.
+	 */
+	void generate(const uint8_t *bytes, uint16_t *words, size_t numWords);
+
+	/**
+	 * @brief Generate an edge capture, like DHTBackendNRF52Edge
+	 *
+	 * @param bytes The 5 bytes to send (4 data bytes and the checksum)
+	 *
+	 * @param edgesUs Buffer to fill in with the time of each level transition in microseconds
+	 * since the line was released. A complete frame has 84 edges.
+	 *
+	 * @param maxEdges Maximum number of edges to store in edgesUs
+	 *
+	 * @return The number of edges stored in edgesUs
+	 */
+	size_t generateEdges(const uint8_t *bytes, uint16_t *edgesUs, size_t maxEdges);
+
+	/**
+	 * @brief Fill in the 5 bytes of a DHT22 frame, including the checksum
+	 *
+	 * @param tempDeciC Temperature in tenths of a degree C (-400 to 800)
+	 *
+	 * @param humidityDeci Relative humidity in tenths of a percent (0 to 1000)
+	 *
+	 * @param bytes Buffer to fill in, must be at least 5 bytes
+	 */
+	static void makeBytesDHT22(int tempDeciC, int humidityDeci, uint8_t *bytes);
+
+	/**
+	 * @brief Fill in the 5 bytes of a DHT11 frame, including the checksum
+	 *
+	 * @param tempC Temperature in degrees C (0 to 50)
+	 *
+	 * @param humidity Relative humidity in percent (20 to 90)
+	 *
+	 * @param bytes Buffer to fill in, must be at least 5 bytes
+	 */
+	static void makeBytesDHT11(int tempC, int humidity, uint8_t *bytes);
+
+protected:
+	/**
+	 * @brief Used internally to generate the periods of the frame
+	 */
+	void generateFrame(const uint8_t *bytes, uint16_t *words, size_t numWords);
+
+	/**
+	 * @brief Used internally to add one period at the given level to the capture
+	 */
+	void addPeriod(bool level, uint32_t nominalUs, uint16_t *words, size_t numWords);
+
+	/**
+	 * @brief Used internally to record an edge when generating an edge capture
+	 */
+	void addEdge();
+
+	/**
+	 * @brief Used internally to get the next pseudo-random number (xorshift32)
+	 */
+	uint32_t nextRandom();
+
+	Timing timing;					//!< Waveform timing
+	uint32_t sampleRate = DEFAULT_SAMPLE_RATE; //!< Samples per second
+	uint16_t jitterUs = 0;			//!< Maximum random change to each period
+	int numBits = 40;				//!< Number of data bits to send
+	uint32_t seed = 1;				//!< Pseudo-random generator state
+	uint64_t timeNs = 0;			//!< Time of the end of the waveform generated so far
+	uint16_t *edgesUs = 0;			//!< Edge buffer when called from generateEdges()
+	size_t maxEdges = 0;			//!< Size of edgesUs
+	size_t numEdges = 0;			//!< Number of edges in edgesUs
+};
+
+#endif /* _DHTCAPTURESYNTH_H */
@@ -0,0 +1,344 @@
+#include "DHTDecoder.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+#include <string.h>
+
+DHTDecoder::DHTDecoder(int oneBitThreshold) {
+	reset(oneBitThreshold);
+}
+
+void DHTDecoder::reset(int oneBitThreshold) {
+	this->oneBitThreshold = oneBitThreshold;
+	level = true;
+	count = 0;
+	pair = -2;
+	lastEdgeUs = 0;
+	memset(bytes, 0, sizeof(bytes));
+	diagnostics = 0;
+}
+
+void DHTDecoder::withDiagnostics(DHTFrameDiagnostics *diagnostics) {
+	this->diagnostics = diagnostics;
+	if (diagnostics) {
+		diagnostics->clear();
+		diagnostics->oneBitThreshold = oneBitThreshold;
+	}
+}
+
+void DHTDecoder::addWords(const uint16_t *words, size_t numWords) {
+	for(size_t ii = 0; ii < numWords; ii++) {
+		uint32_t value = words[ii];
+
+		// Bit n of edges is set when bit n of value differs from the sample before it, which is
+		// bit n + 1, or for bit 15, the last bit of the previous word (the current level)
+		uint32_t edges = (value ^ ((value >> 1) | (level ? 0x8000 : 0))) & 0xffff;
+
+		// Next bit of value not yet added to count
+		int bit = 15;
+
+		while(edges) {
+			int edge = 31 - __builtin_clz(edges);
+
+			// Bits from bit down to edge + 1 continue the current run
+			count += bit - edge;
+			endRun();
+
+			// Bit edge is the first sample of the next run
+			level = !level;
+			count = 1;
+
+			bit = edge - 1;
+			edges ^= (1 << edge);
+		}
+
+		count += bit + 1;
+	}
+}
+
+void DHTDecoder::addEdges(const uint16_t *edgesUs, size_t numEdges) {
+	for(size_t ii = 0; ii < numEdges; ii++) {
+		// Each edge ends the run at the current level
+		count = (uint16_t)(edgesUs[ii] - lastEdgeUs);
+		endRun();
+
+		level = !level;
+		lastEdgeUs = edgesUs[ii];
+	}
+}
+
+void DHTDecoder::endRun() {
+	if (level) {
+		if (pair >= 0 && pair < NUM_BITS) {
+			highWidths[pair] = (uint16_t)count;
+
+			// Normal 0 bit is 26-28 us, 1 bit is 70 us. At 128 kHz that's count = 3 or 9.
+			if (count > oneBitThreshold) {
+				bytes[pair / 8] |= 1 << (7 - (pair % 8));
+			}
+		}
+		if (diagnostics) {
+			recordRun();
+		}
+		pair++;
+	}
+	else
+	if (diagnostics && pair == -1) {
+		diagnostics->startLowWidth = (uint16_t)count;
+	}
+}
+
+void DHTDecoder::recordRun() {
+	if (pair == -2) {
+		diagnostics->releaseWidth = (uint16_t)count;
+	}
+	else
+	if (pair == -1) {
+		diagnostics->startHighWidth = (uint16_t)count;
+	}
+	else
+	if (pair < NUM_BITS) {
+		diagnostics->highWidths[pair] = (uint16_t)count;
+		diagnostics->pairs = pair + 1;
+	}
+}
+
+void DHTDecoder::applyThreshold(int oneBitThreshold) {
+	this->oneBitThreshold = oneBitThreshold;
+
+	memset(bytes, 0, sizeof(bytes));
+	for(int ii = 0; ii < pair && ii < NUM_BITS; ii++) {
+		if (highWidths[ii] > oneBitThreshold) {
+			bytes[ii / 8] |= 1 << (7 - (ii % 8));
+		}
+	}
+
+	if (diagnostics) {
+		diagnostics->oneBitThreshold = oneBitThreshold;
+	}
+}
+
+bool DHTDecoder::adaptThreshold(int minSeparation) {
+	int numWidths = (pair < NUM_BITS) ? pair : NUM_BITS;
+	if (numWidths <= 0) {
+		return false;
+	}
+
+	int threshold = findThreshold(highWidths, (size_t)numWidths, minSeparation);
+	if (threshold < 0) {
+		return false;
+	}
+
+	applyThreshold(threshold);
+	return true;
+}
+
+int DHTDecoder::getMargin(int bit) const {
+	int width = highWidths[bit];
+	return (width > oneBitThreshold) ? (width - oneBitThreshold) : (oneBitThreshold + 1 - width);
+}
+
+int DHTDecoder::repairChecksum(int maxMargin) {
+	if (pair < NUM_BITS || isValidChecksum(bytes)) {
+		return 0;
+	}
+
+	for(int margin = 1; margin <= maxMargin; margin++) {
+		int found = -1;
+		int numFound = 0;
+
+		for(int bit = 0; bit < NUM_BITS; bit++) {
+			if (getMargin(bit) != margin) {
+				continue;
+			}
+			uint8_t mask = (uint8_t)(1 << (7 - (bit % 8)));
+
+			bytes[bit / 8] ^= mask;
+			if (isValidChecksum(bytes)) {
+				found = bit;
+				numFound++;
+			}
+			bytes[bit / 8] ^= mask;
+		}
+
+		if (numFound == 1) {
+			bytes[found / 8] ^= (uint8_t)(1 << (7 - (found % 8)));
+			return margin;
+		}
+		if (numFound > 1) {
+			// More than one equally likely fix, so don't guess
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// [static]
+int DHTDecoder::findThreshold(const uint16_t *highWidths, size_t numWidths, int minSeparation) {
+	if (numWidths < 2) {
+		return -1;
+	}
+
+	int minWidth = highWidths[0];
+	int maxWidth = highWidths[0];
+	for(size_t ii = 1; ii < numWidths; ii++) {
+		if (highWidths[ii] < minWidth) {
+			minWidth = highWidths[ii];
+		}
+		if (highWidths[ii] > maxWidth) {
+			maxWidth = highWidths[ii];
+		}
+	}
+	if (maxWidth - minWidth < minSeparation) {
+		// All of the bits are the same, or too close to tell apart
+		return -1;
+	}
+
+	// Start halfway between the extremes and move the threshold to the midpoint of the two
+	// cluster means until it stops changing. This usually takes two or three passes.
+	int threshold = (minWidth + maxWidth) / 2;
+	uint32_t sum0, sum1, n0, n1;
+
+	for(int iter = 0; iter < 8; iter++) {
+		sum0 = sum1 = n0 = n1 = 0;
+		for(size_t ii = 0; ii < numWidths; ii++) {
+			if (highWidths[ii] > threshold) {
+				sum1 += highWidths[ii];
+				n1++;
+			}
+			else {
+				sum0 += highWidths[ii];
+				n0++;
+			}
+		}
+		if (n0 == 0 || n1 == 0) {
+			return -1;
+		}
+
+		// (sum0 / n0 + sum1 / n1) / 2 without losing the fractions
+		int next = (int)((sum0 * n1 + sum1 * n0) / (2 * n0 * n1));
+		if (next == threshold) {
+			break;
+		}
+		threshold = next;
+	}
+
+	// The difference of the means must be at least minSeparation
+	if ((int64_t)sum1 * n0 - (int64_t)sum0 * n1 < (int64_t)minSeparation * n0 * n1) {
+		return -1;
+	}
+
+	return threshold;
+}
+
+// [static]
+int DHTDecoder::decode(const uint16_t *words, size_t numWords, int oneBitThreshold, uint8_t *bytes, DHTFrameDiagnostics *diagnostics) {
+	DHTDecoder decoder(oneBitThreshold);
+	decoder.withDiagnostics(diagnostics);
+
+	decoder.addWords(words, numWords);
+
+	memcpy(bytes, decoder.getBytes(), NUM_BYTES);
+	if (diagnostics) {
+		diagnostics->calculate();
+	}
+
+	return decoder.getPairs();
+}
+
+// [static]
+int DHTDecoder::decodeEdges(const uint16_t *edgesUs, size_t numEdges, int oneBitThresholdUs, uint8_t *bytes, DHTFrameDiagnostics *diagnostics) {
+	DHTDecoder decoder(oneBitThresholdUs);
+	decoder.withDiagnostics(diagnostics);
+
+	decoder.addEdges(edgesUs, numEdges);
+
+	memcpy(bytes, decoder.getBytes(), NUM_BYTES);
+	if (diagnostics) {
+		diagnostics->sampleRate = 1000000;
+		diagnostics->calculate();
+	}
+
+	return decoder.getPairs();
+}
+
+//
+// Diagnostics
+//
+void DHTFrameDiagnostics::clear() {
+	oneBitThreshold = 0;
+	pairs = 0;
+	checksumValid = false;
+	releaseWidth = startLowWidth = startHighWidth = 0;
+	memset(highWidths, 0, sizeof(highWidths));
+	minMargin = maxMargin = 0;
+	minZeroWidth = maxZeroWidth = minOneWidth = maxOneWidth = 0;
+}
+
+void DHTFrameDiagnostics::calculate() {
+	minMargin = maxMargin = 0;
+	minZeroWidth = maxZeroWidth = minOneWidth = maxOneWidth = 0;
+
+	for(int ii = 0; ii < pairs && ii < NUM_BITS; ii++) {
+		int width = highWidths[ii];
+		int margin;
+		if (width > oneBitThreshold) {
+			margin = width - oneBitThreshold;
+			if (minOneWidth == 0 || width < minOneWidth) {
+				minOneWidth = (uint16_t)width;
+			}
+			if (width > maxOneWidth) {
+				maxOneWidth = (uint16_t)width;
+			}
+		}
+		else {
+			margin = oneBitThreshold + 1 - width;
+			if (minZeroWidth == 0 || width < minZeroWidth) {
+				minZeroWidth = (uint16_t)width;
+			}
+			if (width > maxZeroWidth) {
+				maxZeroWidth = (uint16_t)width;
+			}
+		}
+		if (ii == 0 || margin < minMargin) {
+			minMargin = (int16_t)margin;
+		}
+		if (ii == 0 || margin > maxMargin) {
+			maxMargin = (int16_t)margin;
+		}
+	}
+}
+
+void DHTSensorDiagnostics::add(const DHTFrameDiagnostics &frame) {
+	if (&frame != &lastFrame) {
+		lastFrame = frame;
+	}
+
+	frames++;
+	if (frame.pairs < DHTFrameDiagnostics::NUM_BITS) {
+		incompleteFrames++;
+	}
+	else {
+		if (!frame.checksumValid) {
+			checksumErrors++;
+		}
+		if (frames - incompleteFrames == 1 || frame.minMargin < worstMargin) {
+			worstMargin = frame.minMargin;
+		}
+	}
+
+	for(int ii = 0; ii < frame.pairs && ii < DHTFrameDiagnostics::NUM_BITS; ii++) {
+		size_t bin = frame.toMicros(frame.highWidths[ii]) / BIN_US;
+		if (bin >= NUM_BINS) {
+			bin = NUM_BINS - 1;
+		}
+		highHistogram[bin]++;
+	}
+}
+
+void DHTSensorDiagnostics::reset() {
+	frames = checksumErrors = incompleteFrames = 0;
+	worstMargin = 0;
+	memset(highHistogram, 0, sizeof(highHistogram));
+}
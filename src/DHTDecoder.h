@@ -0,0 +1,359 @@
+#ifndef _DHTDECODER_H
+#define _DHTDECODER_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// This file does not depend on Particle.h so it can also be built and tested on a host computer.
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Timing details of one decoded frame, for finding marginal sensors and wiring
+ *
+ * Widths are the length of high periods in samples at sampleRate (for the I2S capture), or in
+ * microseconds for edge captures (sampleRate is 1000000). Use toMicros() to convert.
+ *
+ * The margin of a bit is how much its high period could change before it would be decoded as the
+ * other value: width - oneBitThreshold for a 1 bit, oneBitThreshold + 1 - width for a 0 bit. A
+ * margin of 1 means a change of one sample would flip the bit.
+ */
+class DHTFrameDiagnostics {
+public:
+	/**
+	 * @brief Number of data bits in a frame
+	 */
+	static const int NUM_BITS = 40;
+
+	/**
+	 * @brief Clears the results, but not sampleRate
+	 */
+	void clear();
+
+	/**
+	 * @brief Calculates the margins and minimum and maximum widths from highWidths
+	 *
+	 * Called by DHTDecoder::decode() and decodeEdges(). If you use addWords() or addEdges(), call
+	 * this after adding the whole frame.
+	 */
+	void calculate();
+
+	/**
+	 * @brief Converts a width to microseconds
+	 */
+	uint32_t toMicros(uint32_t width) const { return sampleRate ? (uint32_t)((uint64_t)width * 1000000 / sampleRate) : 0; };
+
+	uint32_t sampleRate = 0;		//!< Samples per second of the widths, 1000000 for edge captures
+	int oneBitThreshold = 0;		//!< Threshold the frame was decoded with
+	int pairs = 0;					//!< Number of data bits received, 40 for a complete frame
+	bool checksumValid = false;		//!< Checksum was valid (set by DHT22Gen3)
+	uint16_t releaseWidth = 0;		//!< High period from the start of the capture until the sensor responds
+	uint16_t startLowWidth = 0;		//!< Low period of the sensor start sequence (nominally 80 us)
+	uint16_t startHighWidth = 0;	//!< High period of the sensor start sequence (nominally 80 us)
+	uint16_t highWidths[NUM_BITS];	//!< High period of each data bit received
+	int16_t minMargin = 0;			//!< Smallest margin of any data bit
+	int16_t maxMargin = 0;			//!< Largest margin of any data bit
+	uint16_t minZeroWidth = 0;		//!< Shortest high period of a 0 bit (nominally 26-28 us), 0 if none
+	uint16_t maxZeroWidth = 0;		//!< Longest high period of a 0 bit, 0 if none
+	uint16_t minOneWidth = 0;		//!< Shortest high period of a 1 bit (nominally 70 us), 0 if none
+	uint16_t maxOneWidth = 0;		//!< Longest high period of a 1 bit, 0 if none
+};
+
+/**
+ * @brief Cumulative decode statistics for one sensor
+ *
+ * Attach it to a sensor using DHT22Gen3::addDiagnostics() and every frame decoded for that pin is
+ * added, including frames that fail and are retried. The histogram of high periods should have two
+ * narrow peaks, around 27 us (0 bits) and 70 us (1 bits). Peaks that are spreading out or moving
+ * toward the threshold (48 us) indicate a long cable, weak pull-up, or failing sensor before it
+ * starts causing checksum errors.
+ */
+class DHTSensorDiagnostics {
+public:
+	/**
+	 * @brief Number of bins in highHistogram
+	 */
+	static const size_t NUM_BINS = 32;
+
+	/**
+	 * @brief Width of each bin of highHistogram in microseconds
+	 */
+	static const uint32_t BIN_US = 4;
+
+	/**
+	 * @brief Adds a frame to the cumulative statistics and saves it as lastFrame
+	 */
+	void add(const DHTFrameDiagnostics &frame);
+
+	/**
+	 * @brief Clears the cumulative statistics
+	 */
+	void reset();
+
+	DHTFrameDiagnostics lastFrame;	//!< The most recent frame
+	uint32_t frames = 0;			//!< Number of frames decoded
+	uint32_t checksumErrors = 0;	//!< Number of frames with 40 bits and an invalid checksum
+	uint32_t incompleteFrames = 0;	//!< Number of frames with fewer than 40 bits
+	int16_t worstMargin = 0;		//!< Smallest minMargin of any complete frame, valid if frames > incompleteFrames
+
+	/**
+	 * @brief Number of data bit high periods in each 4 us bin (0-3 us, 4-7 us, ...). The last bin
+	 * includes all longer periods.
+	 */
+	uint32_t highHistogram[NUM_BINS] = {0};
+};
+
+/**
+ * @brief Decodes DHT11/DHT22 data from an oversampled capture of the data line
+ *
+ * The capture is a sequence of 16-bit words, most significant bit first, where each bit is the
+ * state of the data line at one sample time (128 kHz for the I2S settings of the built-in sensor
+ * types, DHTCaptureConfig::CONFIG_128K). The line is high at the start of the capture (released, with the pull-up), then
+ * the sensor sends its 80 us low/80 us high start sequence followed by 40 data bits. Each data
+ * bit is a low period followed by a short (0) or long (1) high period.
+ *
+ * The decoder works a word at a time. Instead of testing each bit it finds the level transitions
+ * in each word and measures the length of each run of high bits, so a word with no transitions
+ * costs one comparison.
+ *
+ * You can feed the capture in pieces using addWords(), or decode a whole buffer at once using
+ * the static decode() method.
+ *
+ * Backends that capture the time of each level transition instead of oversampling the line
+ * (DHTBackendNRF52Edge) use addEdges() or decodeEdges(). The runs are measured the same way, but
+ * in microseconds instead of samples.
+ */
+class DHTDecoder {
+public:
+	/**
+	 * @brief Number of data bits in a DHT11/DHT22 frame
+	 */
+	static const int NUM_BITS = 40;
+
+	/**
+	 * @brief Number of data bytes in a DHT11/DHT22 frame, including the checksum
+	 */
+	static const size_t NUM_BYTES = 5;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param oneBitThreshold A high run longer than this number of samples is a 1 bit. The default
+	 * is the threshold of the built-in sensor types at 128 kHz (DHTCaptureConfig::CONFIG_128K).
+	 */
+	DHTDecoder(int oneBitThreshold = 6);
+
+	/**
+	 * @brief Sets the decoder back to the start of a frame
+	 *
+	 * @param oneBitThreshold A high run longer than this number of samples is a 1 bit
+	 */
+	void reset(int oneBitThreshold);
+
+	/**
+	 * @brief Decode additional captured words
+	 *
+	 * @param words Pointer to the captured words, most significant bit first
+	 *
+	 * @param numWords Number of 16-bit words to process
+	 *
+	 * This can be called multiple times with consecutive parts of a capture.
+	 */
+	void addWords(const uint16_t *words, size_t numWords);
+
+	/**
+	 * @brief Decode additional edge timestamps
+	 *
+	 * @param edgesUs Time of each level transition in microseconds since the line was released
+	 * after the start pulse. The line is high before the first edge. Times wrap at 65536 us, which
+	 * is much longer than a frame.
+	 *
+	 * @param numEdges Number of timestamps to process
+	 *
+	 * When decoding edges the oneBitThreshold is in microseconds. This can be called multiple
+	 * times with consecutive parts of a capture, but not mixed with addWords().
+	 */
+	void addEdges(const uint16_t *edgesUs, size_t numEdges);
+
+	/**
+	 * @brief Record the timing of the frame
+	 *
+	 * @param diagnostics Filled in as the frame is decoded, or 0 to not record timing (the default).
+	 * It's cleared, except for sampleRate, which you should set.
+	 *
+	 * Call this after reset().
+	 */
+	void withDiagnostics(DHTFrameDiagnostics *diagnostics);
+
+	/**
+	 * @brief Returns the object set using withDiagnostics(), or 0 if timing is not being recorded
+	 */
+	DHTFrameDiagnostics *getDiagnostics() const { return diagnostics; };
+
+	/**
+	 * @brief Returns the number of high periods ended so far, not counting the start sequence
+	 *
+	 * A complete frame is 40 (NUM_BITS). Before the start sequence is received this is negative.
+	 */
+	int getPairs() const { return pair; };
+
+	/**
+	 * @brief Returns the decoded bytes (NUM_BYTES of them)
+	 *
+	 * Bits that have not been received yet are 0.
+	 */
+	const uint8_t *getBytes() const { return bytes; };
+
+	/**
+	 * @brief Returns the length of the high period of each data bit received so far
+	 *
+	 * There are getPairs() valid entries (up to NUM_BITS), in samples or microseconds.
+	 */
+	const uint16_t *getHighWidths() const { return highWidths; };
+
+	/**
+	 * @brief Returns the threshold the bits are currently decoded with
+	 */
+	int getOneBitThreshold() const { return oneBitThreshold; };
+
+	/**
+	 * @brief Decodes the bits received so far again using a different threshold
+	 *
+	 * @param oneBitThreshold A high run longer than this number of samples (or microseconds) is a 1 bit
+	 *
+	 * Bits received after this call use the new threshold as well.
+	 */
+	void applyThreshold(int oneBitThreshold);
+
+	/**
+	 * @brief Decodes the bits received so far again using a threshold found from their high periods
+	 *
+	 * @param minSeparation See findThreshold()
+	 *
+	 * @return true if the threshold was changed, false if the high periods could not be separated
+	 * into 0 and 1 bits and the threshold was left unchanged.
+	 *
+	 * Call this after a complete frame is received.
+	 */
+	bool adaptThreshold(int minSeparation);
+
+	/**
+	 * @brief Returns how far the high period of a bit is from the threshold
+	 *
+	 * @param bit The data bit, 0 to getPairs() - 1
+	 *
+	 * @return width - oneBitThreshold for a 1 bit, oneBitThreshold + 1 - width for a 0 bit, the
+	 * same as DHTFrameDiagnostics. 1 means a change of one sample would flip the bit.
+	 */
+	int getMargin(int bit) const;
+
+	/**
+	 * @brief Tries to fix a frame with an invalid checksum by flipping one low confidence bit
+	 *
+	 * @param maxMargin Only bits with a margin (see getMargin()) of at most this value are
+	 * considered
+	 *
+	 * @return The margin of the bit that was flipped, or 0 if the frame was not changed
+	 *
+	 * The bits are tried starting with the smallest margin. If flipping exactly one bit with that
+	 * margin makes the checksum valid, it's flipped. If more than one would, the frame is
+	 * ambiguous and is left unchanged. Call this after a complete frame is received.
+	 */
+	int repairChecksum(int maxMargin);
+
+	/**
+	 * @brief Returns true if the last byte of a frame is the sum of the other four
+	 *
+	 * @param bytes The frame, NUM_BYTES bytes
+	 */
+	static bool isValidChecksum(const uint8_t *bytes) { return (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]) == bytes[4]; };
+
+	/**
+	 * @brief Finds the threshold between 0 and 1 bits from the high periods of a frame
+	 *
+	 * @param highWidths Length of the high period of each data bit
+	 *
+	 * @param numWidths Number of entries in highWidths
+	 *
+	 * @param minSeparation The average 1 bit must be at least this much longer than the average
+	 * 0 bit, otherwise the frame is assumed to contain only one kind of bit.
+	 *
+	 * @return The threshold, or -1 if the widths could not be separated into two groups.
+	 *
+	 * The widths are split into two clusters (two-means) and the threshold is the midpoint of the
+	 * average of each cluster. This follows the actual pulse widths of a sensor with a long cable,
+	 * weak pull-up, or non-standard timing instead of using a fixed threshold.
+	 */
+	static int findThreshold(const uint16_t *highWidths, size_t numWidths, int minSeparation);
+
+	/**
+	 * @brief Decode a complete capture
+	 *
+	 * @param words Pointer to the captured words, most significant bit first
+	 *
+	 * @param numWords Number of 16-bit words in words
+	 *
+	 * @param oneBitThreshold A high run longer than this number of samples is a 1 bit
+	 *
+	 * @param bytes Filled in with the decoded data. Must have room for NUM_BYTES bytes.
+	 *
+	 * @return The number of data bits found. 40 (NUM_BITS) is a complete frame.
+	 */
+	static int decode(const uint16_t *words, size_t numWords, int oneBitThreshold, uint8_t *bytes) { return decode(words, numWords, oneBitThreshold, bytes, 0); };
+
+	/**
+	 * @brief Decode a complete capture and record its timing
+	 *
+	 * @param diagnostics If not 0, filled in with the timing of the frame. Set its sampleRate
+	 * before calling.
+	 *
+	 * The other parameters and the return value are the same as the other decode().
+	 */
+	static int decode(const uint16_t *words, size_t numWords, int oneBitThreshold, uint8_t *bytes, DHTFrameDiagnostics *diagnostics);
+
+	/**
+	 * @brief Decode a complete edge capture
+	 *
+	 * @param edgesUs Time of each level transition in microseconds since the line was released
+	 *
+	 * @param numEdges Number of timestamps in edgesUs
+	 *
+	 * @param oneBitThresholdUs A high period longer than this number of microseconds is a 1 bit
+	 *
+	 * @param bytes Filled in with the decoded data. Must have room for NUM_BYTES bytes.
+	 *
+	 * @return The number of data bits found. 40 (NUM_BITS) is a complete frame.
+	 */
+	static int decodeEdges(const uint16_t *edgesUs, size_t numEdges, int oneBitThresholdUs, uint8_t *bytes) { return decodeEdges(edgesUs, numEdges, oneBitThresholdUs, bytes, 0); };
+
+	/**
+	 * @brief Decode a complete edge capture and record its timing
+	 *
+	 * @param diagnostics If not 0, filled in with the timing of the frame, in microseconds.
+	 *
+	 * The other parameters and the return value are the same as the other decodeEdges().
+	 */
+	static int decodeEdges(const uint16_t *edgesUs, size_t numEdges, int oneBitThresholdUs, uint8_t *bytes, DHTFrameDiagnostics *diagnostics);
+
+protected:
+	/**
+	 * @brief Used internally when a run of samples at the current level ends
+	 */
+	void endRun();
+
+	/**
+	 * @brief Used internally to record the length of a high run in diagnostics
+	 */
+	void recordRun();
+
+	int oneBitThreshold;		//!< A high run longer than this number of samples (or microseconds) is a 1 bit
+	bool level = true;			//!< Level of the current run (the line is high when the capture starts)
+	int count = 0;				//!< Number of samples in the current run
+	uint16_t lastEdgeUs = 0;	//!< Time of the previous edge, for addEdges()
+	int pair = -2;				//!< Number of high periods ended, starting at -2 for the start sequence
+	uint8_t bytes[NUM_BYTES];	//!< Decoded data
+	uint16_t highWidths[NUM_BITS]; //!< High period of each data bit, for applyThreshold()
+	DHTFrameDiagnostics *diagnostics = 0; //!< Timing of the frame is recorded here, if not 0
+};
+
+#endif /* _DHTDECODER_H */
@@ -0,0 +1,91 @@
+#ifndef _DHTQUEUE_H
+#define _DHTQUEUE_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// This file does not depend on Particle.h so it can also be built and tested on a host computer.
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * @brief Fixed size lock-free queue with a single producer and a single consumer
+ *
+ * @param T The type of entry. It's copied in and out of the queue by assignment.
+ *
+ * @param N The maximum number of entries in the queue
+ *
+ * One thread (or interrupt handler) calls push() and another calls pop(), without a mutex. The
+ * entry is written before the tail index is published, and read before the head index is
+ * published, so neither side ever sees a partially copied entry. If there is more than one
+ * producer or more than one consumer, those calls must be protected by a mutex.
+ *
+ * Used by DHT22Gen3 to pass requests to the worker thread and samples back to loop(), see
+ * DHT22Gen3::withWorkerThread().
+ */
+template<class T, size_t N>
+class DHTQueue {
+public:
+	/**
+	 * @brief Adds an entry to the end of the queue. Only call from the producer.
+	 *
+	 * @return true if added, false if the queue is full
+	 */
+	bool push(const T &entry) {
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % (N + 1);
+		if (next == headIndex.load(std::memory_order_acquire)) {
+			return false;
+		}
+		entries[tail] = entry;
+		tailIndex.store(next, std::memory_order_release);
+		return true;
+	};
+
+	/**
+	 * @brief Removes the entry at the beginning of the queue. Only call from the consumer.
+	 *
+	 * @param entry Filled in with the entry that was removed
+	 *
+	 * @return true if an entry was removed, false if the queue is empty
+	 */
+	bool pop(T &entry) {
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailIndex.load(std::memory_order_acquire)) {
+			return false;
+		}
+		entry = entries[head];
+		headIndex.store((head + 1) % (N + 1), std::memory_order_release);
+		return true;
+	};
+
+	/**
+	 * @brief Returns the number of entries in the queue
+	 *
+	 * This can be called from either side, but the other side may change it at any time.
+	 */
+	size_t getCount() const {
+		size_t head = headIndex.load(std::memory_order_acquire);
+		size_t tail = tailIndex.load(std::memory_order_acquire);
+		return (tail + N + 1 - head) % (N + 1);
+	};
+
+	/**
+	 * @brief Returns true if there are no entries in the queue
+	 */
+	bool isEmpty() const { return getCount() == 0; };
+
+	/**
+	 * @brief Returns the maximum number of entries, N
+	 */
+	static constexpr size_t getCapacity() { return N; };
+
+protected:
+	T entries[N + 1]; //!< One more than N so a full queue can be told apart from an empty one
+	std::atomic<size_t> headIndex{0}; //!< Index into entries of the oldest entry. Written by the consumer.
+	std::atomic<size_t> tailIndex{0}; //!< Index into entries where the next entry will be written. Written by the producer.
+};
+
+#endif /* _DHTQUEUE_H */
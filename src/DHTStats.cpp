@@ -0,0 +1,86 @@
+#include "DHTStats.h"
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+#include <math.h>
+
+DHTRunningStats &DHTRunningStats::withEwmaAlpha(float alpha) {
+	if (alpha < 0) {
+		alpha = 0;
+	}
+	if (alpha > 1) {
+		alpha = 1;
+	}
+	ewmaAlphaQ16 = (uint32_t)(alpha * 65536 + 0.5f);
+	return *this;
+}
+
+DHTRunningStats &DHTRunningStats::withWindowSize(uint16_t windowSize) {
+	this->windowSize = windowSize ? windowSize : 1;
+	windowCount = 0;
+	windowSum = 0;
+	return *this;
+}
+
+void DHTRunningStats::add(int16_t value) {
+	int32_t valueQ8 = (int32_t)value * 256;
+
+	if (count == 0) {
+		min = max = value;
+		ewmaQ8 = valueQ8;
+	}
+	else {
+		if (value < min) {
+			min = value;
+		}
+		if (value > max) {
+			max = value;
+		}
+		ewmaQ8 += (int32_t)(((int64_t)ewmaAlphaQ16 * (valueQ8 - ewmaQ8) + 32768) >> 16);
+	}
+
+	// Welford's method. The mean is recalculated from the exact sum each time so rounding errors
+	// in it don't accumulate.
+	count++;
+	sum += value;
+	int32_t newMeanQ8 = (int32_t)roundDiv(sum * 256, count);
+	m2Q16 += (int64_t)(valueQ8 - meanQ8) * (valueQ8 - newMeanQ8);
+	meanQ8 = newMeanQ8;
+
+	windowSum += value;
+	if (++windowCount >= windowSize) {
+		windowMean = (int16_t)roundDiv(windowSum, windowCount);
+		windowComplete = true;
+		windowCount = 0;
+		windowSum = 0;
+	}
+}
+
+void DHTRunningStats::reset() {
+	count = 0;
+	min = max = 0;
+	sum = 0;
+	meanQ8 = 0;
+	m2Q16 = 0;
+	ewmaQ8 = 0;
+	windowCount = 0;
+	windowSum = 0;
+	windowMean = 0;
+	windowComplete = false;
+}
+
+int16_t DHTRunningStats::getMean() const {
+	return count ? (int16_t)roundDiv(sum, count) : 0;
+}
+
+float DHTRunningStats::getVariance() const {
+	if (count < 2) {
+		return 0;
+	}
+	return (float)m2Q16 / 65536.0f / (float)(count - 1);
+}
+
+float DHTRunningStats::getStdDev() const {
+	return sqrtf(getVariance());
+}
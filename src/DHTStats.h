@@ -0,0 +1,166 @@
+#ifndef _DHTSTATS_H
+#define _DHTSTATS_H
+
+// Repository: https://github.com/rickkas7/DHT22Gen3_RK
+// License: MIT
+
+// This file does not depend on Particle.h so it can also be built and tested on a host computer.
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Running statistics for a stream of integer values
+ *
+ * The statistics are updated as each value is added, using a fixed amount of memory and without
+ * storing the values:
+ *
+ * - Minimum and maximum
+ * - Mean, calculated from an exact 64-bit sum
+ * - Sample variance and standard deviation, using Welford's method with the mean in fixed point
+ * - Exponentially weighted moving average (EWMA)
+ * - Mean of the last complete window of a fixed number of values
+ *
+ * All of the results are in the same units as the values. When used by DHT22Gen3 (DHTSensorStats)
+ * these are tenths of a degree C or tenths of a percent. Only integer math is used when adding
+ * values; getVariance() and getStdDev() use single precision float.
+ */
+class DHTRunningStats {
+public:
+	/**
+	 * @brief Constructor
+	 */
+	DHTRunningStats() {};
+
+	/**
+	 * @brief Sets the weight of each new value in the EWMA (0 - 1). Default is 0.1.
+	 *
+	 * Larger values follow changes more quickly, smaller values smooth more.
+	 */
+	DHTRunningStats &withEwmaAlpha(float alpha);
+
+	/**
+	 * @brief Sets the number of values in each window for getWindowMean(). Default is 30.
+	 *
+	 * This also discards the window in progress.
+	 */
+	DHTRunningStats &withWindowSize(uint16_t windowSize);
+
+	/**
+	 * @brief Adds a value
+	 */
+	void add(int16_t value);
+
+	/**
+	 * @brief Clears all of the statistics. The EWMA alpha and window size are not changed.
+	 */
+	void reset();
+
+	/**
+	 * @brief Returns the number of values added since construction or reset()
+	 */
+	uint32_t getCount() const { return count; };
+
+	/**
+	 * @brief Returns the smallest value added, or 0 if none
+	 */
+	int16_t getMin() const { return min; };
+
+	/**
+	 * @brief Returns the largest value added, or 0 if none
+	 */
+	int16_t getMax() const { return max; };
+
+	/**
+	 * @brief Returns the mean of all values added, rounded, or 0 if none
+	 */
+	int16_t getMean() const;
+
+	/**
+	 * @brief Returns the sample variance (divided by n - 1), in units squared, or 0 if fewer than 2 values
+	 */
+	float getVariance() const;
+
+	/**
+	 * @brief Returns the sample standard deviation, or 0 if fewer than 2 values
+	 */
+	float getStdDev() const;
+
+	/**
+	 * @brief Returns the exponentially weighted moving average, rounded, or 0 if no values
+	 *
+	 * The first value initializes the average.
+	 */
+	int16_t getEwma() const { return (int16_t)((ewmaQ8 + 128) >> 8); };
+
+	/**
+	 * @brief Returns the mean of the last complete window of values, rounded
+	 *
+	 * Values are grouped into consecutive windows of the window size. Returns 0 until the first
+	 * window is complete; see hasWindowMean().
+	 */
+	int16_t getWindowMean() const { return windowMean; };
+
+	/**
+	 * @brief Returns true if at least one window is complete, so getWindowMean() is valid
+	 */
+	bool hasWindowMean() const { return windowComplete; };
+
+protected:
+	/**
+	 * @brief Used internally to divide and round to the nearest integer
+	 */
+	static int64_t roundDiv(int64_t num, int64_t den) { return (num + ((num >= 0) ? den / 2 : -den / 2)) / den; };
+
+	uint32_t count = 0;			//!< Number of values added
+	int16_t min = 0;			//!< Smallest value
+	int16_t max = 0;			//!< Largest value
+	int64_t sum = 0;			//!< Sum of all values
+	int32_t meanQ8 = 0;			//!< Mean multiplied by 256, for the variance
+	int64_t m2Q16 = 0;			//!< Sum of squares of differences from the mean (Welford M2), multiplied by 65536
+	uint32_t ewmaAlphaQ16 = 6554; //!< EWMA alpha multiplied by 65536
+	int32_t ewmaQ8 = 0;			//!< EWMA multiplied by 256
+	uint16_t windowSize = 30;	//!< Number of values in each window
+	uint16_t windowCount = 0;	//!< Number of values in the current window
+	int32_t windowSum = 0;		//!< Sum of the values in the current window
+	int16_t windowMean = 0;		//!< Mean of the last complete window
+	bool windowComplete = false; //!< At least one window has been completed
+};
+
+/**
+ * @brief Running statistics for the temperature and humidity of one sensor
+ *
+ * Attach it to a sensor with DHT22Gen3::addStats() and each successful sample is added. You can
+ * also call add() yourself. The values are in tenths of a degree C and tenths of a percent, so
+ * for example temperature.getMean() of 215 is 21.5 C.
+ */
+class DHTSensorStats {
+public:
+	/**
+	 * @brief Sets the EWMA alpha of both the temperature and humidity. See DHTRunningStats::withEwmaAlpha().
+	 */
+	DHTSensorStats &withEwmaAlpha(float alpha) { temperature.withEwmaAlpha(alpha); humidity.withEwmaAlpha(alpha); return *this; };
+
+	/**
+	 * @brief Sets the window size of both the temperature and humidity. See DHTRunningStats::withWindowSize().
+	 */
+	DHTSensorStats &withWindowSize(uint16_t windowSize) { temperature.withWindowSize(windowSize); humidity.withWindowSize(windowSize); return *this; };
+
+	/**
+	 * @brief Adds a sample
+	 *
+	 * @param tempDeciC Temperature in tenths of a degree C (DHTSample::getTempDeciC())
+	 *
+	 * @param humidityDeci Humidity in tenths of a percent (DHTSample::getHumidityDeci())
+	 */
+	void add(int16_t tempDeciC, int16_t humidityDeci) { temperature.add(tempDeciC); humidity.add(humidityDeci); };
+
+	/**
+	 * @brief Clears the statistics
+	 */
+	void reset() { temperature.reset(); humidity.reset(); };
+
+	DHTRunningStats temperature;	//!< Temperature statistics in tenths of a degree C
+	DHTRunningStats humidity;		//!< Humidity statistics in tenths of a percent
+};
+
+#endif /* _DHTSTATS_H */